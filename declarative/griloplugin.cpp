@@ -25,6 +25,7 @@
 #include <GriloQt>
 #include <GriloDataSource>
 #include <GriloBrowse>
+#include <GriloGroupModel>
 #include <GriloMedia>
 #include <GriloMultiSearch>
 #include <GriloQuery>
@@ -46,6 +47,7 @@ void GriloPlugin::registerTypes(const char *uri)
 {
     qmlRegisterType<GriloRegistry>(uri, 0, 1, "GriloRegistry");
     qmlRegisterType<DeclarativeGriloModel>(uri, 0, 1, "GriloModel");
+    qmlRegisterType<GriloGroupModel>(uri, 0, 1, "GriloGroupModel");
     qmlRegisterType<GriloBrowse>(uri, 0, 1, "GriloBrowse");
     qmlRegisterType<GriloSearch>(uri, 0, 1, "GriloSearch");
     qmlRegisterType<GriloQuery>(uri, 0, 1, "GriloQuery");
@@ -2,6 +2,10 @@ TEMPLATE = subdirs
 declarative.depends = src
 SUBDIRS = src declarative
 
+benchmarks.subdir = tests/benchmarks
+benchmarks.depends = src
+SUBDIRS += benchmarks
+
 # example_simple.subdir = example/simple
 # example_simple.depends = src
 # SUBDIRS += example_simple
@@ -22,6 +22,7 @@
 #include "grilobrowse.h"
 #include "griloregistry.h"
 #include "grilomedia.h"
+#include "grilotrace.h"
 
 #include <QDebug>
 
@@ -58,8 +59,28 @@ GriloBrowse::~GriloBrowse()
 
 bool GriloBrowse::refresh()
 {
+    if (deferRefresh()) {
+        return true;
+    }
+
     cancelRefresh();
 
+    if (followSharedResults()) {
+        return true;
+    }
+
+    loadCache();
+
+    return startOperation();
+}
+
+QString GriloBrowse::operationKey() const
+{
+    return QString::fromLatin1("browse|%1|%2").arg(d->m_source, d->m_baseMedia);
+}
+
+bool GriloBrowse::startOperation()
+{
     GriloRegistry *registry = getGriloRegistry();
 
     if (!registry) {
@@ -79,12 +100,13 @@ bool GriloBrowse::refresh()
         return false;
     }
 
-    GList *keys = keysAsList();
+    GList *keys = keysAsList(src);
     GrlOperationOptions *options = operationOptions(src, Browse);
 
     setFetching(true);
     guint opId = grl_source_browse(src, rootMedia(),
                                    keys, options, grilo_source_result_cb, this);
+    GRILO_TRACE_INSTANT_ARG("browse", "operation", opId);
     setOpId(opId);
 
     g_object_unref(options);
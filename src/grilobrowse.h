@@ -65,6 +65,8 @@ Q_SIGNALS:
     void baseMediaChanged();
 
 private:
+    bool startOperation();
+    QString operationKey() const;
     void availableSourcesChanged();
     GrlMedia *rootMedia();
 
@@ -23,294 +23,3052 @@
 #include "grilomedia.h"
 #include "grilomodel.h"
 #include "griloregistry.h"
+#include "grilotrace.h"
 
+#include <QCollator>
+#include <QCollatorSortKey>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QPointer>
+#include <QQueue>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringMatcher>
+#include <QThreadPool>
 #include <QTimerEvent>
+#include <QtNumeric>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcOperation, "grilo.qt.operation", QtWarningMsg)
+
+// Slow key resolutions running at once and accessed rows waiting for one
+static const int maxDeferredOps = 8;
+static const int maxDeferredQueue = 64;
+
+// Results waiting in the queue at most, more are applied right away
+static const int resultQueueCapacity = 4096;
+
+// Result cache file: magic, version and row count followed by every row as
+// its length and the serialized media, all in native byte order.
+static const char cacheMagic[4] = { 'G', 'Q', 'R', 'C' };
+static const quint32 cacheVersion = 1;
+
+// Every search text gets a cache file of its own, only the most recently
+// written ones are kept within these limits.
+static const int maxCacheFiles = 64;
+static const qint64 maxCacheBytes = 32 * 1024 * 1024;
+
+static void evict_cache_files(const QString &dir)
+{
+    QFileInfoList files = QDir(dir).entryInfoList(QDir::Files, QDir::Time);
+    qint64 size = 0;
+
+    for (int i = 0; i < files.count(); ++i) {
+        size += files.at(i).size();
+        if (i >= maxCacheFiles || size > maxCacheBytes) {
+            QFile::remove(files.at(i).absoluteFilePath());
+        }
+    }
+}
+
+// Writes a result cache file on the cache writer thread
+class GriloCacheWrite : public QRunnable
+{
+public:
+    GriloCacheWrite(const QString &path, const QByteArray &data)
+        : m_path(path)
+        , m_data(data)
+    {
+    }
+
+    void run()
+    {
+        QString dir = QFileInfo(m_path).absolutePath();
+        QDir().mkpath(dir);
+
+        QSaveFile file(m_path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(m_data) != m_data.size() || !file.commit()) {
+            qWarning() << "Failed to write result cache" << m_path;
+            return;
+        }
+
+        evict_cache_files(dir);
+    }
+
+private:
+    QString m_path;
+    QByteArray m_data;
+};
+
+// One thread so that the writes and evictions do not race each other
+class GriloCacheWriter : public QThreadPool
+{
+public:
+    GriloCacheWriter()
+    {
+        setMaxThreadCount(1);
+    }
+};
+
+Q_GLOBAL_STATIC(GriloCacheWriter, cacheWriter)
 
 static void fill_key_id(gpointer data, gpointer user_data)
 {
-    QVariantList *varList = static_cast<QVariantList *>(user_data);
-    varList->append(GriloDataSource::MetadataKeys(GRLPOINTER_TO_KEYID(data)));
+    QVariantList *varList = static_cast<QVariantList *>(user_data);
+    varList->append(GriloDataSource::MetadataKeys(GRLPOINTER_TO_KEYID(data)));
+}
+
+// Compact record kept for every row. The GriloMedia wrapper is only
+// created when somebody asks for the media object.
+struct GriloMediaRow
+{
+    GriloMediaRow()
+        : media(nullptr)
+        , wrapper(nullptr)
+        , mediaType(GRL_MEDIA_TYPE_UNKNOWN)
+        , duration(0)
+        , size(0)
+        , deferred(false)
+        , generation(0)
+        , slot(-1)
+    {
+    }
+
+    GrlMedia *media;
+    // Shared with the key of the id to row hash
+    QString id;
+    GriloMedia *wrapper;
+
+    QString title;
+    // Title, artist and album case folded and separated by newlines, matched
+    // against the text of a local refinement
+    QString searchText;
+    int mediaType;
+    int duration;
+    qint64 size;
+    QString genre;
+
+    // Fetched without the slow keys, which are resolved once the row is accessed
+    bool deferred;
+
+    // Values of the sort keys, text and other keys separately in sort key order.
+    // QCollatorSortKey cannot be default constructed as QVector requires.
+    // Rows placed by GriloDataSource::mergeMedia() keep their merge keys here
+    // instead, see GriloDataSourcePrivate::compareMerged().
+    std::vector<QCollatorSortKey> textKeys;
+    QVector<double> numberKeys;
+    // Fetch which last returned the row when sorting
+    uint generation;
+    // Slot in the column store, -1 if not stored
+    int slot;
+};
+
+Q_DECLARE_TYPEINFO(GriloMediaRow, Q_MOVABLE_TYPE);
+
+static void fill_row(GriloMediaRow &row, GrlMedia *media)
+{
+    row.media = media;
+    row.title = QString::fromUtf8(grl_media_get_title(media));
+    row.searchText = (row.title + QLatin1Char('\n') + QString::fromUtf8(grl_media_get_artist(media))
+                      + QLatin1Char('\n') + QString::fromUtf8(grl_media_get_album(media))).toCaseFolded();
+    row.mediaType = grl_media_get_media_type(media);
+    row.duration = grl_media_get_duration(media);
+    row.size = grl_media_get_size(media);
+    row.genre = QString::fromUtf8(grl_media_get_genre(media));
+}
+
+static QString media_type_name(int type)
+{
+    switch (type) {
+    case GRL_MEDIA_TYPE_AUDIO:
+        return QStringLiteral("audio");
+    case GRL_MEDIA_TYPE_VIDEO:
+        return QStringLiteral("video");
+    case GRL_MEDIA_TYPE_IMAGE:
+        return QStringLiteral("image");
+    case GRL_MEDIA_TYPE_CONTAINER:
+        return QStringLiteral("container");
+    default:
+        return QStringLiteral("unknown");
+    }
+}
+
+// Results of an operation shared by the data sources asking for the same thing
+struct GriloSharedResults
+{
+    QString key;
+    QString source;
+    // Data source running the operation, null once it completed
+    GriloDataSource *owner;
+    // Data sources waiting for the results of the running operation
+    QList<QPointer<GriloDataSource> > followers;
+    QVector<GrlMedia *> media;
+    // Data sources showing the results
+    int users;
+    // Still in the cache, otherwise deleted with its last user
+    bool cached;
+};
+
+// Process wide cache of shared results. Entries nobody shows are dropped,
+// least recently used first, once the cached rows exceed the limit.
+class GriloResultCache
+{
+public:
+    GriloResultCache()
+        : m_limit(10000)
+    {
+    }
+
+    ~GriloResultCache()
+    {
+        Q_FOREACH (GriloSharedResults *entry, m_lru) {
+            destroy(entry);
+        }
+    }
+
+    GriloSharedResults *acquire(const QString &key)
+    {
+        GriloSharedResults *entry = m_entries.value(key);
+        if (entry) {
+            m_lru.removeOne(entry);
+            m_lru.append(entry);
+            ++entry->users;
+        }
+        return entry;
+    }
+
+    GriloSharedResults *create(const QString &key, const QString &source, GriloDataSource *owner)
+    {
+        if (GriloSharedResults *previous = m_entries.value(key)) {
+            drop(previous);
+        }
+
+        GriloSharedResults *entry = new GriloSharedResults;
+        entry->key = key;
+        entry->source = source;
+        entry->owner = owner;
+        entry->users = 1;
+        entry->cached = true;
+
+        m_entries.insert(key, entry);
+        m_lru.append(entry);
+
+        return entry;
+    }
+
+    void finish(GriloSharedResults *entry, bool succeeded)
+    {
+        entry->owner = 0;
+        entry->followers.clear();
+
+        if (!succeeded) {
+            drop(entry);
+        }
+        trim();
+    }
+
+    void release(GriloSharedResults *entry, GriloDataSource *source)
+    {
+        entry->followers.removeAll(QPointer<GriloDataSource>(source));
+
+        if (entry->owner == source) {
+            // Cancelled before completing, the followers run their own operation.
+            entry->owner = 0;
+            Q_FOREACH (const QPointer<GriloDataSource> &follower, entry->followers) {
+                if (follower) {
+                    QMetaObject::invokeMethod(follower, "refresh", Qt::QueuedConnection);
+                }
+            }
+            entry->followers.clear();
+            drop(entry);
+        }
+
+        if (--entry->users == 0 && !entry->cached) {
+            destroy(entry);
+        } else {
+            trim();
+        }
+    }
+
+    void invalidate(const QString &source)
+    {
+        // Operations on several sources have none recorded.
+        Q_FOREACH (GriloSharedResults *entry, m_lru) {
+            if (entry->source == source || entry->source.isEmpty()) {
+                drop(entry);
+            }
+        }
+    }
+
+    int limit() const
+    {
+        return m_limit;
+    }
+
+    void setLimit(int limit)
+    {
+        m_limit = limit;
+        trim();
+    }
+
+private:
+    void drop(GriloSharedResults *entry)
+    {
+        if (!entry->cached) {
+            return;
+        }
+
+        entry->cached = false;
+        m_entries.remove(entry->key);
+        m_lru.removeOne(entry);
+
+        if (entry->users == 0) {
+            destroy(entry);
+        }
+    }
+
+    void destroy(GriloSharedResults *entry)
+    {
+        Q_FOREACH (GrlMedia *media, entry->media) {
+            g_object_unref(media);
+        }
+        delete entry;
+    }
+
+    void trim()
+    {
+        int size = 0;
+        Q_FOREACH (GriloSharedResults *entry, m_lru) {
+            size += entry->media.count();
+        }
+
+        for (int i = 0; size > m_limit && i < m_lru.count();) {
+            GriloSharedResults *entry = m_lru.at(i);
+            if (entry->users == 0) {
+                size -= entry->media.count();
+                drop(entry);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    QHash<QString, GriloSharedResults *> m_entries;
+    QList<GriloSharedResults *> m_lru;
+    int m_limit;
+};
+
+Q_GLOBAL_STATIC(GriloResultCache, resultCache)
+
+struct GriloSortSpec
+{
+    int key;
+    bool text;
+    bool descending;
+};
+
+// Column oriented copy of the requested keys of the rows. Every row owns a
+// slot in all columns, slots of removed rows are reused. Numbers are packed
+// in arrays, text is kept once in a pool and referred to by its offset.
+class GriloColumnStore
+{
+public:
+    struct Column
+    {
+        int key;
+        GType type;
+        // Integers, booleans and dates as milliseconds since the epoch
+        QVector<qint64> integers;
+        QVector<double> reals;
+        // Pool offsets
+        QVector<int> texts;
+    };
+
+    static const qint64 missingInteger;
+    enum { missingText = -1 };
+
+    GriloColumnStore()
+        : m_slots(0)
+        , m_generation(0)
+    {
+    }
+
+    void setKeys(const QVariantList &keys)
+    {
+        clear();
+        m_columns.clear();
+        m_columnOf.clear();
+
+        Q_FOREACH (const QVariant &var, keys) {
+            Column column;
+            column.key = var.toInt();
+            column.type = column.key > 0 ? grl_metadata_key_get_type(column.key) : G_TYPE_INVALID;
+            if (column.type == G_TYPE_STRING || column.type == G_TYPE_INT || column.type == G_TYPE_INT64
+                    || column.type == G_TYPE_FLOAT || column.type == G_TYPE_BOOLEAN
+                    || column.type == G_TYPE_DATE_TIME) {
+                if (!m_columnOf.contains(column.key)) {
+                    m_columnOf.insert(column.key, m_columns.count());
+                    m_columns.append(column);
+                }
+            }
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return m_columns.isEmpty();
+    }
+
+    int column(int key) const
+    {
+        return m_columnOf.value(key, -1);
+    }
+
+    const Column &columnAt(int column) const
+    {
+        return m_columns.at(column);
+    }
+
+    int allocate()
+    {
+        if (!m_free.isEmpty()) {
+            int slot = m_free.last();
+            m_free.removeLast();
+            return slot;
+        }
+
+        for (int i = 0; i < m_columns.count(); ++i) {
+            Column &column = m_columns[i];
+            if (column.type == G_TYPE_STRING) {
+                column.texts.append(missingText);
+            } else if (column.type == G_TYPE_FLOAT) {
+                column.reals.append(qQNaN());
+            } else {
+                column.integers.append(missingInteger);
+            }
+        }
+        return m_slots++;
+    }
+
+    void release(int slot)
+    {
+        m_free.append(slot);
+        if (m_free.count() == m_slots) {
+            clear();
+        }
+    }
+
+    void store(int slot, GrlMedia *media)
+    {
+        GrlData *data = GRL_DATA(media);
+
+        for (int i = 0; i < m_columns.count(); ++i) {
+            Column &column = m_columns[i];
+            bool present = grl_data_has_key(data, column.key);
+
+            if (column.type == G_TYPE_STRING) {
+                const char *text = present ? grl_data_get_string(data, column.key) : 0;
+                column.texts[slot] = text ? intern(text) : missingText;
+            } else if (column.type == G_TYPE_FLOAT) {
+                column.reals[slot] = present ? grl_data_get_float(data, column.key) : qQNaN();
+            } else if (!present) {
+                column.integers[slot] = missingInteger;
+            } else if (column.type == G_TYPE_INT) {
+                column.integers[slot] = grl_data_get_int(data, column.key);
+            } else if (column.type == G_TYPE_INT64) {
+                column.integers[slot] = grl_data_get_int64(data, column.key);
+            } else if (column.type == G_TYPE_BOOLEAN) {
+                column.integers[slot] = grl_data_get_boolean(data, column.key);
+            } else {
+                GDateTime *dateTime = static_cast<GDateTime *>(grl_data_get_boxed(data, column.key));
+                column.integers[slot] = dateTime
+                        ? g_date_time_to_unix(dateTime) * 1000 + g_date_time_get_microsecond(dateTime) / 1000
+                        : missingInteger;
+            }
+        }
+    }
+
+    bool number(int column, int slot, double *value) const
+    {
+        const Column &c = m_columns.at(column);
+        if (c.type == G_TYPE_FLOAT) {
+            *value = c.reals.at(slot);
+            return !qIsNaN(*value);
+        }
+
+        qint64 integer = c.integers.at(slot);
+        *value = integer;
+        return integer != missingInteger;
+    }
+
+    const char *text(int column, int slot) const
+    {
+        int offset = m_columns.at(column).texts.at(slot);
+        return offset == missingText ? 0 : m_pool.constData() + offset;
+    }
+
+    // Offset of text already in the pool, missingText otherwise
+    int find(const QByteArray &text) const
+    {
+        return m_interned.value(text, missingText);
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < m_columns.count(); ++i) {
+            m_columns[i].integers.clear();
+            m_columns[i].reals.clear();
+            m_columns[i].texts.clear();
+        }
+        m_free.clear();
+        m_slots = 0;
+        m_pool.clear();
+        m_interned.clear();
+        ++m_generation;
+    }
+
+    // Changes whenever columns or pool offsets found before are no longer valid
+    int generation() const
+    {
+        return m_generation;
+    }
+
+private:
+    int intern(const char *text)
+    {
+        QByteArray bytes = QByteArray::fromRawData(text, qstrlen(text));
+        QHash<QByteArray, int>::const_iterator it = m_interned.constFind(bytes);
+        if (it != m_interned.constEnd()) {
+            return it.value();
+        }
+
+        int offset = m_pool.size();
+        // Terminated so the pool can be handed out as C strings
+        m_pool.append(bytes).append('\0');
+        m_interned.insert(QByteArray(bytes.constData(), bytes.size()), offset);
+        return offset;
+    }
+
+    QVector<Column> m_columns;
+    QHash<int, int> m_columnOf;
+    QVector<int> m_free;
+    int m_slots;
+    QByteArray m_pool;
+    QHash<QByteArray, int> m_interned;
+    int m_generation;
+};
+
+const qint64 GriloColumnStore::missingInteger = std::numeric_limits<qint64>::min();
+
+// Filter of a GriloModel. Values are read from the cached row fields, the
+// column store or straight from the GrlMedia, without converting them to QVariant.
+struct GriloRowFilter
+{
+    GriloRowFilter()
+        : key(0)
+        , type(G_TYPE_INVALID)
+        , column(-1)
+        , hasMin(false)
+        , hasMax(false)
+        , min(0)
+        , max(0)
+    {
+    }
+
+    int key;
+    GType type;
+    // Column of the key in the column store, -1 if not projected
+    int column;
+    // Matched against the media type of the row when not empty
+    QSet<int> mediaTypes;
+    bool hasMin;
+    bool hasMax;
+    double min;
+    double max;
+    QVector<double> numbers;
+    QByteArray prefix;
+    QSet<QByteArray> values;
+    // Pool offsets of the values found in the column store
+    QSet<int> offsets;
+};
+
+// Filters of a model, compiled again only when the column store changes
+struct GriloModelFilters
+{
+    GriloModelFilters()
+        : generation(-1)
+    {
+    }
+
+    QVariantList filters;
+    QVector<GriloRowFilter> compiled;
+    int generation;
+};
+
+static double filter_number(const QVariant &value)
+{
+    if (value.type() == QVariant::DateTime) {
+        return value.toDateTime().toMSecsSinceEpoch();
+    }
+    return value.toDouble();
+}
+
+static QVector<GriloRowFilter> compile_filters(const QVariantList &filters, const GriloColumnStore &store)
+{
+    QVector<GriloRowFilter> compiled;
+
+    Q_FOREACH (const QVariant &var, filters) {
+        QVariantMap map = var.toMap();
+        GriloRowFilter filter;
+
+        if (map.contains("mediaType")) {
+            QVariant types = map.value("mediaType");
+            if (types.type() == QVariant::List) {
+                Q_FOREACH (const QVariant &type, types.toList()) {
+                    filter.mediaTypes.insert(type.toInt());
+                }
+            } else {
+                filter.mediaTypes.insert(types.toInt());
+            }
+            compiled.append(filter);
+            continue;
+        }
+
+        filter.key = map.value("key").toInt();
+        filter.type = filter.key > 0 ? grl_metadata_key_get_type(filter.key) : G_TYPE_INVALID;
+        if (filter.type == G_TYPE_INVALID) {
+            qWarning() << "Ignoring filter on unknown metadata key" << map.value("key");
+            continue;
+        }
+        filter.column = store.column(filter.key);
+
+        QVariantList values = map.contains("values") ? map.value("values").toList() : QVariantList();
+        if (map.contains("value")) {
+            values.append(map.value("value"));
+        }
+
+        if (filter.type == G_TYPE_STRING) {
+            if (map.contains("prefix")) {
+                filter.prefix = map.value("prefix").toString().toUtf8();
+            } else if (!values.isEmpty()) {
+                Q_FOREACH (const QVariant &value, values) {
+                    QByteArray text = value.toString().toUtf8();
+                    filter.values.insert(text);
+                    int offset = store.find(text);
+                    if (offset != GriloColumnStore::missingText) {
+                        filter.offsets.insert(offset);
+                    }
+                }
+            } else {
+                qWarning() << "Ignoring filter without prefix or values on text key" << filter.key;
+                continue;
+            }
+        } else {
+            filter.hasMin = map.contains("min");
+            filter.hasMax = map.contains("max");
+            filter.min = filter_number(map.value("min"));
+            filter.max = filter_number(map.value("max"));
+            Q_FOREACH (const QVariant &value, values) {
+                filter.numbers.append(filter_number(value));
+            }
+            if (!filter.hasMin && !filter.hasMax && filter.numbers.isEmpty()) {
+                qWarning() << "Ignoring filter without range or values on key" << filter.key;
+                continue;
+            }
+        }
+
+        compiled.append(filter);
+    }
+
+    return compiled;
+}
+
+static bool filter_number_value(const GriloRowFilter &filter, const GriloMediaRow &row,
+                                const GriloColumnStore &store, double *value)
+{
+    if (filter.key == GRL_METADATA_KEY_DURATION) {
+        // The cached duration reads 0 when the media has none.
+        if (!grl_data_has_key(GRL_DATA(row.media), filter.key)) {
+            return false;
+        }
+        *value = row.duration;
+        return true;
+    }
+
+    if (filter.column != -1 && row.slot != -1) {
+        return store.number(filter.column, row.slot, value);
+    }
+
+    GrlData *data = GRL_DATA(row.media);
+    if (!grl_data_has_key(data, filter.key)) {
+        return false;
+    }
+
+    if (filter.type == G_TYPE_INT) {
+        *value = grl_data_get_int(data, filter.key);
+    } else if (filter.type == G_TYPE_INT64) {
+        *value = grl_data_get_int64(data, filter.key);
+    } else if (filter.type == G_TYPE_FLOAT) {
+        *value = grl_data_get_float(data, filter.key);
+    } else if (filter.type == G_TYPE_BOOLEAN) {
+        *value = grl_data_get_boolean(data, filter.key);
+    } else if (filter.type == G_TYPE_DATE_TIME) {
+        GDateTime *dateTime = static_cast<GDateTime *>(grl_data_get_boxed(data, filter.key));
+        if (!dateTime) {
+            return false;
+        }
+        *value = g_date_time_to_unix(dateTime) * 1000.0 + g_date_time_get_microsecond(dateTime) / 1000;
+    } else {
+        *value = filter_number(GriloMedia::value(row.media, filter.key));
+    }
+
+    return true;
+}
+
+static bool filter_matches(const GriloRowFilter &filter, const GriloMediaRow &row, const GriloColumnStore &store)
+{
+    if (!filter.mediaTypes.isEmpty()) {
+        return filter.mediaTypes.contains(row.mediaType);
+    }
+
+    if (filter.type != G_TYPE_STRING) {
+        double value;
+        if (!filter_number_value(filter, row, store, &value)) {
+            return false;
+        }
+        if (!filter.numbers.isEmpty()) {
+            return filter.numbers.contains(value);
+        }
+        return (!filter.hasMin || value >= filter.min) && (!filter.hasMax || value <= filter.max);
+    }
+
+    if (filter.column != -1 && row.slot != -1) {
+        if (filter.prefix.isNull()) {
+            // Interned, equal text has the same offset
+            int offset = store.columnAt(filter.column).texts.at(row.slot);
+            if (filter.offsets.contains(offset)) {
+                return true;
+            }
+            // Values first interned after the filter was compiled
+            if (offset == GriloColumnStore::missingText || filter.offsets.count() == filter.values.count()) {
+                return false;
+            }
+            const char *text = store.text(filter.column, row.slot);
+            return filter.values.contains(QByteArray::fromRawData(text, qstrlen(text)));
+        }
+        const char *text = store.text(filter.column, row.slot);
+        return text && qstrncmp(text, filter.prefix.constData(), filter.prefix.size()) == 0;
+    }
+
+    const char *text = grl_data_get_string(GRL_DATA(row.media), filter.key);
+    if (!text) {
+        return false;
+    }
+    if (!filter.prefix.isNull()) {
+        return qstrncmp(text, filter.prefix.constData(), filter.prefix.size()) == 0;
+    }
+    return filter.values.contains(QByteArray::fromRawData(text, qstrlen(text)));
+}
+
+// Fenwick tree counting the rows of the previous fetch which have not been
+// matched yet by a re-fetch.
+class GriloRowCounter
+{
+public:
+    void reset(int size)
+    {
+        m_tree.fill(0, size + 1);
+        for (int i = 1; i <= size; ++i) {
+            m_tree[i] += 1;
+            int parent = i + (i & -i);
+            if (parent <= size) {
+                m_tree[parent] += m_tree[i];
+            }
+        }
+    }
+
+    void clear()
+    {
+        m_tree.clear();
+    }
+
+    void remove(int position)
+    {
+        for (int i = position + 1; i < m_tree.size(); i += i & -i) {
+            --m_tree[i];
+        }
+    }
+
+    // Number of rows still counted before position
+    int before(int position) const
+    {
+        int sum = 0;
+        for (int i = position; i > 0; i -= i & -i) {
+            sum += m_tree[i];
+        }
+        return sum;
+    }
+
+private:
+    QVector<int> m_tree;
+};
+
+// Result of the running operation applied later from the event loop. Grilo
+// calls back on the GUI thread, so the queue is only used from there.
+struct GriloQueuedResult
+{
+    GrlMedia *media;
+    guint remaining;
+    bool failed;
+};
+
+// What the running operation took and did to the rows, see GriloDataSource::stats()
+struct GriloOperationStats
+{
+    enum Change {
+        Inserts,
+        Moves,
+        Updates,
+        Removals,
+        Resets,
+        ChangeCount
+    };
+
+    GriloOperationStats()
+    {
+        start();
+    }
+
+    void start()
+    {
+        timer.start();
+        firstResult = -1;
+        lastResult = -1;
+        results = 0;
+        std::fill(changes, changes + ChangeCount, 0);
+        modelSignals = 0;
+    }
+
+    void result()
+    {
+        lastResult = timer.elapsed();
+        if (firstResult == -1) {
+            firstResult = lastResult;
+        }
+        ++results;
+    }
+
+    // Rows changed by one notification of every model
+    void count(Change change, int rows, int models)
+    {
+        changes[change] += rows;
+        modelSignals += models;
+    }
+
+    QVariantMap toMap() const
+    {
+        QVariantMap map;
+        map.insert("duration", timer.elapsed());
+        map.insert("firstResult", firstResult);
+        map.insert("lastResult", lastResult);
+        map.insert("results", results);
+        map.insert("inserts", changes[Inserts]);
+        map.insert("moves", changes[Moves]);
+        map.insert("updates", changes[Updates]);
+        map.insert("removals", changes[Removals]);
+        map.insert("resets", changes[Resets]);
+        map.insert("modelSignals", modelSignals);
+        return map;
+    }
+
+    QElapsedTimer timer;
+    // Milliseconds since the start, -1 without results
+    qint64 firstResult;
+    qint64 lastResult;
+    int results;
+    int changes[ChangeCount];
+    int modelSignals;
+};
+
+class GriloDataSourcePrivate
+{
+public:
+    GriloDataSourcePrivate(GriloDataSource *q);
+
+    int rowOf(const QString &id, int *unmatchedPosition = 0);
+    void renumber();
+    void renumber(int first, int last);
+    void beginRefetch();
+    void endRefetch();
+    void placedAt(const QString &id, int row);
+    void queueDeferredKeys(GriloMediaRow &row);
+    int typeFilterFlags() const;
+    void fillSortKeys(GriloMediaRow &row);
+    void appendSortKey(GriloMediaRow &row, const GriloSortSpec &spec);
+    void storeColumns(GriloMediaRow &row);
+    void releaseColumns(GriloMediaRow &row);
+    void rebuildColumns();
+    void account(const GriloMediaRow &row, int sign);
+    void clearAggregates();
+    int compareRows(const GriloMediaRow &left, const GriloMediaRow &right) const;
+    int sortedPosition(const GriloMediaRow &row) const;
+    int compareMerged(const GriloMediaRow &left, const GriloMediaRow &right) const;
+
+    GriloDataSource *q;
+
+    guint m_opId;
+    GriloRegistry *m_registry;
+
+    int m_count;
+    int m_skip;
+    int m_insertIndex;
+
+    // Paging, the running operation fetches m_pageCount items starting at m_pageOffset
+    int m_pageSize;
+    int m_pageOffset;
+    int m_pageCount;
+    int m_pageResults;
+    bool m_moreAvailable;
+
+    // Sparse mode keeps m_totalCount placeholder rows and fills in a page
+    // when one of its rows is accessed. One page is fetched at a time.
+    bool sparse() const { return m_totalCount > 0 && m_pageSize > 0; }
+    int m_totalCount;
+    int m_maxResidentPages;
+    int m_fetchingPage;
+    int m_lastPage;
+    QList<int> m_residentPages;
+    // Resident pages fetched before the last refresh
+    QSet<int> m_stalePages;
+    // Requested pages, most recently requested last
+    QList<int> m_pageQueue;
+
+    QVariantList m_metadataKeys;
+    QVariantList m_typeFilter;
+
+    // The metadata keys of the rows are also kept in m_columns
+    bool m_columnar;
+    GriloColumnStore m_columns;
+
+    bool m_updateScheduled;
+    QBasicTimer m_updateTimer;
+    QVector<GriloMediaRow> m_media;
+    // Only built for callers of GriloDataSource::media()
+    QList<GriloMedia *> m_mediaList;
+    bool m_mediaListValid;
+
+    // New rows waiting to be inserted at m_insertIndex as one range, or when
+    // sorting at their sorted place in as few ranges as possible
+    QVector<GriloMediaRow> m_pending;
+    bool m_pendingSorted;
+    int m_batchSize;
+    int m_batchInterval;
+    QBasicTimer m_flushTimer;
+    QElapsedTimer m_pendingSince;
+
+    QList<GriloModel *> m_models;
+    // Filters of the filtered models, see GriloDataSource::setFilters
+    QHash<GriloModel *, GriloModelFilters> m_modelFilters;
+
+    // Maps media ids to rows. Rows are only trusted below m_validRows and are
+    // renumbered lazily. While a re-fetch is running the rows left over from
+    // the previous fetch are stored as -(position when the re-fetch started) - 1
+    // and their current row is resolved through m_unmatched.
+    QHash<QString, int> m_rows;
+    int m_validRows;
+    bool m_refetching;
+    GriloRowCounter m_unmatched;
+
+    // Content changes applied without a full refetch
+    bool m_incrementalUpdates;
+    QString m_changedSource;
+    bool m_locationUnknown;
+    QList<guint> m_resolveOps;
+
+    int m_resolution;
+    bool m_deferSlowKeys;
+    // Slow keys left out of the running operation and the source to resolve them from
+    QList<int> m_deferredKeys;
+    QString m_deferredSource;
+    QList<guint> m_deferredOps;
+    // Ids of accessed rows waiting for a free slot, most recently accessed last.
+    // Accessing a row only queues it, the resolutions start from m_deferredTimer.
+    QStringList m_deferredQueue;
+    QBasicTimer m_deferredTimer;
+
+    // Rows are kept ordered by m_sortSpec when set. A fetch marks the rows it
+    // returns with a new generation and removes the others when it completes.
+    bool sorted() const { return !m_sortSpec.isEmpty() && !sparse(); }
+    QVariantList m_sortKeys;
+    QList<GriloSortSpec> m_sortSpec;
+    QCollator m_collator;
+    uint m_generation;
+    bool m_sweeping;
+
+    // Results of the last completed fetch are kept on disk
+    bool m_diskCache;
+
+    // Results shared with other data sources running the same operation
+    bool m_sharedResults;
+    GriloSharedResults *m_shared;
+    // Source of the running operation
+    QString m_operationSource;
+
+    // Refreshes wait for refreshDelay ms without another one, at most refreshMaxWait ms
+    int m_refreshDelay;
+    int m_refreshMaxWait;
+    QBasicTimer m_refreshTimer;
+    QElapsedTimer m_refreshPendingSince;
+    bool m_refreshing;
+    // Operation key of the running or pending refresh
+    QString m_refreshKey;
+    int m_avoidedOperations;
+
+    // Running totals over the rows with media, aggregatesChanged is emitted
+    // once the changes of an event loop iteration are done
+    qint64 m_totalDuration;
+    qint64 m_totalSize;
+    QHash<int, int> m_typeCounts;
+    QHash<QString, int> m_genreCounts;
+    QBasicTimer m_aggregatesTimer;
+
+    // Results of the running operation waiting to be applied, for at most
+    // m_drainBudget ms per event loop iteration unless they land in the viewport
+    bool inViewport(int row) const { return !sorted() && row <= m_viewportLast; }
+    bool m_queueResults;
+    QQueue<GriloQueuedResult> m_queue;
+    QBasicTimer m_drainTimer;
+    int m_drainBudget;
+    int m_viewportLast;
+
+    // Counters of the running operation and those of the last one finished
+    GriloOperationStats m_stats;
+    QVariantMap m_lastStats;
+
+    bool m_fetching;
+    bool m_initialFetchDone = false;
+    QString m_previouslyAddedId;
+};
+
+GriloDataSourcePrivate::GriloDataSourcePrivate(GriloDataSource *q)
+    : q(q)
+    , m_opId(0)
+    , m_registry(nullptr)
+    , m_count(0)
+    , m_skip(0)
+    , m_insertIndex(0)
+    , m_pageSize(0)
+    , m_pageOffset(0)
+    , m_pageCount(0)
+    , m_pageResults(0)
+    , m_moreAvailable(false)
+    , m_totalCount(0)
+    , m_maxResidentPages(10)
+    , m_fetchingPage(-1)
+    , m_lastPage(0)
+    , m_columnar(false)
+    , m_updateScheduled(false)
+    , m_mediaListValid(false)
+    , m_pendingSorted(false)
+    , m_batchSize(500)
+    , m_batchInterval(16)
+    , m_validRows(0)
+    , m_refetching(false)
+    , m_incrementalUpdates(false)
+    , m_locationUnknown(false)
+    , m_resolution(GRL_RESOLVE_IDLE_RELAY)
+    , m_deferSlowKeys(false)
+    , m_generation(0)
+    , m_sweeping(false)
+    , m_diskCache(false)
+    , m_sharedResults(false)
+    , m_shared(nullptr)
+    , m_refreshDelay(0)
+    , m_refreshMaxWait(0)
+    , m_refreshing(false)
+    , m_avoidedOperations(0)
+    , m_totalDuration(0)
+    , m_totalSize(0)
+    , m_queueResults(false)
+    , m_drainBudget(4)
+    , m_viewportLast(-1)
+    , m_fetching(false)
+{
+    m_metadataKeys << GriloDataSource::Title;
+    m_typeFilter << GriloDataSource::None;
+
+    m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+    m_collator.setNumericMode(true);
+}
+
+int GriloDataSourcePrivate::rowOf(const QString &id, int *unmatchedPosition)
+{
+    if (unmatchedPosition) {
+        *unmatchedPosition = -1;
+    }
+
+    if (id.isEmpty()) {
+        return -1;
+    }
+
+    QHash<QString, int>::iterator it = m_rows.find(id);
+    if (it == m_rows.end()) {
+        return -1;
+    }
+
+    if (it.value() < 0 && m_refetching) {
+        int position = -it.value() - 1;
+        if (unmatchedPosition) {
+            *unmatchedPosition = position;
+        }
+        return m_insertIndex + m_unmatched.before(position);
+    }
+
+    if (it.value() < 0 || it.value() >= m_validRows) {
+        renumber();
+    }
+
+    return it.value();
+}
+
+void GriloDataSourcePrivate::renumber()
+{
+    // While re-fetching only the rows already placed by this fetch are
+    // numbered, the remaining ones keep their position encoding.
+    int end = m_refetching ? m_insertIndex : m_media.count();
+
+    for (int i = m_validRows; i < end; ++i) {
+        const QString &id = m_media.at(i).id;
+        if (!id.isEmpty()) {
+            m_rows.insert(id, i);
+        }
+    }
+
+    m_validRows = end;
+}
+
+void GriloDataSourcePrivate::renumber(int first, int last)
+{
+    // Rows from m_validRows on are renumbered when looked at anyway.
+    last = qMin(last, m_validRows - 1);
+
+    for (int i = first; i <= last; ++i) {
+        const QString &id = m_media.at(i).id;
+        if (!id.isEmpty()) {
+            m_rows.insert(id, i);
+        }
+    }
+}
+
+void GriloDataSourcePrivate::beginRefetch()
+{
+    int count = m_media.count();
+
+    for (int i = 0; i < count; ++i) {
+        const QString &id = m_media.at(i).id;
+        if (!id.isEmpty()) {
+            m_rows.insert(id, -i - 1);
+        }
+    }
+
+    m_unmatched.reset(count);
+    m_validRows = 0;
+    m_refetching = true;
+}
+
+void GriloDataSourcePrivate::endRefetch()
+{
+    if (m_refetching) {
+        m_refetching = false;
+        m_unmatched.clear();
+        m_validRows = 0;
+    }
+}
+
+void GriloDataSourcePrivate::placedAt(const QString &id, int row)
+{
+    if (!id.isEmpty()) {
+        m_rows.insert(id, row);
+    }
+
+    if (m_validRows == row) {
+        ++m_validRows;
+    } else if (m_validRows > row) {
+        m_validRows = row;
+    }
+}
+
+void GriloDataSourcePrivate::queueDeferredKeys(GriloMediaRow &row)
+{
+    row.deferred = false;
+
+    if (m_deferredKeys.isEmpty() || row.id.isEmpty()) {
+        return;
+    }
+
+    m_deferredQueue.append(row.id);
+    if (m_deferredQueue.count() > maxDeferredQueue) {
+        // Scrolled past, let those be picked up again when they come back into view.
+        int dropped = rowOf(m_deferredQueue.takeFirst());
+        if (dropped != -1) {
+            m_media[dropped].deferred = true;
+        }
+    }
+
+    if (!m_deferredTimer.isActive()) {
+        m_deferredTimer.start(0, q);
+    }
+}
+
+void GriloDataSourcePrivate::fillSortKeys(GriloMediaRow &row)
+{
+    row.textKeys.clear();
+    row.numberKeys.clear();
+
+    Q_FOREACH (const GriloSortSpec &spec, m_sortSpec) {
+        appendSortKey(row, spec);
+    }
+}
+
+void GriloDataSourcePrivate::appendSortKey(GriloMediaRow &row, const GriloSortSpec &spec)
+{
+    int column = spec.text || row.slot == -1 ? -1 : m_columns.column(spec.key);
+    if (column != -1) {
+        double number;
+        row.numberKeys.append(m_columns.number(column, row.slot, &number) ? number : 0);
+        return;
+    }
+
+    if (!spec.text && row.media && grl_metadata_key_get_type(spec.key) == G_TYPE_DATE_TIME) {
+        // In milliseconds like the columns, the QVariant only has seconds.
+        GDateTime *dateTime = static_cast<GDateTime *>(grl_data_get_boxed(GRL_DATA(row.media), spec.key));
+        row.numberKeys.append(dateTime
+                              ? g_date_time_to_unix(dateTime) * 1000.0 + g_date_time_get_microsecond(dateTime) / 1000
+                              : 0);
+        return;
+    }
+
+    QVariant value = row.media ? GriloMedia::value(row.media, spec.key) : QVariant();
+    if (spec.text) {
+        row.textKeys.push_back(m_collator.sortKey(value.toString()));
+    } else if (value.type() == QVariant::DateTime) {
+        row.numberKeys.append(value.toDateTime().toMSecsSinceEpoch());
+    } else {
+        row.numberKeys.append(value.toDouble());
+    }
+}
+
+void GriloDataSourcePrivate::storeColumns(GriloMediaRow &row)
+{
+    if (!m_columnar || !row.media || m_columns.isEmpty()) {
+        return;
+    }
+
+    if (row.slot == -1) {
+        row.slot = m_columns.allocate();
+    }
+    m_columns.store(row.slot, row.media);
+}
+
+void GriloDataSourcePrivate::releaseColumns(GriloMediaRow &row)
+{
+    if (row.slot != -1) {
+        m_columns.release(row.slot);
+        row.slot = -1;
+    }
+}
+
+void GriloDataSourcePrivate::rebuildColumns()
+{
+    m_columns.setKeys(m_columnar ? m_metadataKeys : QVariantList());
+
+    for (int i = 0; i < m_media.count(); ++i) {
+        m_media[i].slot = -1;
+        storeColumns(m_media[i]);
+    }
+    for (int i = 0; i < m_pending.count(); ++i) {
+        m_pending[i].slot = -1;
+        storeColumns(m_pending[i]);
+    }
+}
+
+void GriloDataSourcePrivate::account(const GriloMediaRow &row, int sign)
+{
+    if (!row.media) {
+        return;
+    }
+
+    m_totalDuration += sign * row.duration;
+    m_totalSize += sign * row.size;
+
+    int &typeCount = m_typeCounts[row.mediaType];
+    typeCount += sign;
+    if (typeCount == 0) {
+        m_typeCounts.remove(row.mediaType);
+    }
+
+    if (!row.genre.isEmpty()) {
+        int &genreCount = m_genreCounts[row.genre];
+        genreCount += sign;
+        if (genreCount == 0) {
+            m_genreCounts.remove(row.genre);
+        }
+    }
+
+    if (!m_aggregatesTimer.isActive()) {
+        m_aggregatesTimer.start(0, q);
+    }
+}
+
+void GriloDataSourcePrivate::clearAggregates()
+{
+    if (m_typeCounts.isEmpty()) {
+        return;
+    }
+
+    m_totalDuration = 0;
+    m_totalSize = 0;
+    m_typeCounts.clear();
+    m_genreCounts.clear();
+
+    if (!m_aggregatesTimer.isActive()) {
+        m_aggregatesTimer.start(0, q);
+    }
+}
+
+int GriloDataSourcePrivate::compareRows(const GriloMediaRow &left, const GriloMediaRow &right) const
+{
+    int text = 0;
+    int number = 0;
+
+    Q_FOREACH (const GriloSortSpec &spec, m_sortSpec) {
+        int order;
+        if (spec.text) {
+            order = left.textKeys.at(text).compare(right.textKeys.at(text));
+            ++text;
+        } else {
+            double l = left.numberKeys.at(number);
+            double r = right.numberKeys.at(number);
+            order = l < r ? -1 : (r < l ? 1 : 0);
+            ++number;
+        }
+
+        if (order != 0) {
+            return spec.descending ? -order : order;
+        }
+    }
+
+    return 0;
+}
+
+// Merged rows keep in numberKeys whether the merge key is missing, its value
+// unless it is text, which is in textKeys, and last the order of the row.
+int GriloDataSourcePrivate::compareMerged(const GriloMediaRow &left, const GriloMediaRow &right) const
+{
+    // Rows which were not merged, from the cache for instance, go first.
+    if (left.numberKeys.isEmpty() || right.numberKeys.isEmpty()) {
+        return int(right.numberKeys.isEmpty()) - int(left.numberKeys.isEmpty());
+    }
+
+    // Rows without a value go last.
+    double l = left.numberKeys.first();
+    double r = right.numberKeys.first();
+    if (l != r) {
+        return l < r ? -1 : 1;
+    }
+
+    if (!left.textKeys.empty() && !right.textKeys.empty()) {
+        int order = left.textKeys.front().compare(right.textKeys.front());
+        if (order != 0) {
+            return order;
+        }
+    } else if (left.numberKeys.count() > 2 && right.numberKeys.count() > 2) {
+        l = left.numberKeys.at(1);
+        r = right.numberKeys.at(1);
+        if (l != r) {
+            return l < r ? -1 : 1;
+        }
+    }
+
+    l = left.numberKeys.last();
+    r = right.numberKeys.last();
+    return l < r ? -1 : (r < l ? 1 : 0);
+}
+
+int GriloDataSourcePrivate::sortedPosition(const GriloMediaRow &row) const
+{
+    // After the equal rows, so rows keep the order they arrived in.
+    int first = 0;
+    int last = m_media.count();
+
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+        if (compareRows(m_media.at(middle), row) <= 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+int GriloDataSourcePrivate::typeFilterFlags() const
+{
+    int typeFilter = 0;
+    Q_FOREACH (const QVariant &var, m_typeFilter) {
+        if (var.canConvert<int>()) {
+            typeFilter |= var.toInt();
+        }
+    }
+
+    return typeFilter;
+}
+
+GriloDataSource::GriloDataSource(QObject *parent)
+    : QObject(parent)
+    , d(new GriloDataSourcePrivate(this))
+{
+}
+
+GriloDataSource::~GriloDataSource()
+{
+    // Nobody is interested in the pending rows any more.
+    while (!d->m_queue.isEmpty()) {
+        GriloQueuedResult result = d->m_queue.dequeue();
+        if (result.media) {
+            g_object_unref(result.media);
+        }
+        if (result.remaining == 0) {
+            // Completed, nothing to cancel.
+            d->m_opId = 0;
+        }
+    }
+    Q_FOREACH (const GriloMediaRow &row, d->m_pending) {
+        g_object_unref(row.media);
+    }
+    d->m_pending.clear();
+    cancelRefresh();
+    d->m_models.clear();
+
+    // The wrappers are children of ours and hold their own reference.
+    Q_FOREACH (const GriloMediaRow &row, d->m_media) {
+        if (row.media) {
+            g_object_unref(row.media);
+        }
+    }
+    delete d;
+}
+
+const QList<GriloMedia *> *GriloDataSource::media() const
+{
+    if (!d->m_mediaListValid) {
+        d->m_mediaList.clear();
+        d->m_mediaList.reserve(d->m_media.count());
+        for (int i = 0; i < d->m_media.count(); ++i) {
+            d->m_mediaList.append(mediaAt(i));
+        }
+        d->m_mediaListValid = true;
+    }
+
+    return &d->m_mediaList;
+}
+
+int GriloDataSource::mediaCount() const
+{
+    return d->m_media.count();
+}
+
+GriloMedia *GriloDataSource::mediaAt(int index) const
+{
+    GriloMediaRow &row = d->m_media[index];
+
+    if (!row.media) {
+        const_cast<GriloDataSource *>(this)->requestPage(index / d->m_pageSize);
+        return 0;
+    }
+
+    if (!row.wrapper) {
+        g_object_ref(row.media);
+        row.wrapper = new GriloMedia(row.media, const_cast<GriloDataSource *>(this));
+    }
+
+    if (row.deferred) {
+        d->queueDeferredKeys(d->m_media[index]);
+    }
+
+    return row.wrapper;
+}
+
+QVariant GriloDataSource::mediaValue(int index, quint32 keyId) const
+{
+    const GriloMediaRow &row = d->m_media.at(index);
+
+    if (!row.media) {
+        const_cast<GriloDataSource *>(this)->requestPage(index / d->m_pageSize);
+        return QVariant();
+    }
+
+    if (d->sparse()) {
+        d->m_lastPage = index / d->m_pageSize;
+        if (d->m_stalePages.contains(d->m_lastPage)) {
+            const_cast<GriloDataSource *>(this)->requestPage(d->m_lastPage);
+        }
+    }
+
+    if (row.deferred) {
+        d->queueDeferredKeys(d->m_media[index]);
+    }
+
+    if (row.wrapper) {
+        return row.wrapper->get(keyId);
+    }
+
+    switch (keyId) {
+    case GRL_METADATA_KEY_ID:
+        return row.id.isNull() ? QVariant() : QVariant(row.id);
+    case GRL_METADATA_KEY_TITLE:
+        return row.title.isNull() ? QVariant() : QVariant(row.title);
+    default:
+        return GriloMedia::value(row.media, keyId);
+    }
+}
+
+QVariant GriloDataSource::cachedValue(int index, quint32 keyId) const
+{
+    const GriloMediaRow &row = d->m_media.at(index);
+
+    if (!row.media) {
+        return QVariant();
+    }
+
+    switch (keyId) {
+    case GRL_METADATA_KEY_ID:
+        return row.id.isNull() ? QVariant() : QVariant(row.id);
+    case GRL_METADATA_KEY_TITLE:
+        return row.title.isNull() ? QVariant() : QVariant(row.title);
+    default: {
+        int column = row.slot == -1 ? -1 : d->m_columns.column(keyId);
+        if (column != -1 && d->m_columns.columnAt(column).type == G_TYPE_STRING) {
+            const char *text = d->m_columns.text(column, row.slot);
+            return text ? QVariant(QString::fromUtf8(text)) : QVariant();
+        }
+        return GriloMedia::value(row.media, keyId);
+    }
+    }
+}
+
+void GriloDataSource::setFilters(GriloModel *model, const QVariantList &filters)
+{
+    if (filters.isEmpty()) {
+        d->m_modelFilters.remove(model);
+        return;
+    }
+
+    GriloModelFilters &modelFilters = d->m_modelFilters[model];
+    modelFilters.filters = filters;
+    modelFilters.compiled = compile_filters(filters, d->m_columns);
+    modelFilters.generation = d->m_columns.generation();
+}
+
+QVector<int> GriloDataSource::matchingRows(GriloModel *model, int first, int last) const
+{
+    QHash<GriloModel *, GriloModelFilters>::iterator it = d->m_modelFilters.find(model);
+    if (it == d->m_modelFilters.end()) {
+        qWarning() << "No filters set for model" << model;
+        return QVector<int>();
+    }
+
+    GriloModelFilters &modelFilters = it.value();
+    if (modelFilters.generation != d->m_columns.generation()) {
+        modelFilters.compiled = compile_filters(modelFilters.filters, d->m_columns);
+        modelFilters.generation = d->m_columns.generation();
+    }
+
+    const QVector<GriloRowFilter> &compiled = modelFilters.compiled;
+    QVector<int> rows;
+
+    for (int i = first; i <= last; ++i) {
+        const GriloMediaRow &row = d->m_media.at(i);
+        bool matches = true;
+        // Rows of pages not fetched yet are kept until their data arrives.
+        for (int j = 0; row.media && matches && j < compiled.count(); ++j) {
+            matches = filter_matches(compiled.at(j), row, d->m_columns);
+        }
+        if (matches) {
+            rows.append(i);
+        }
+    }
+
+    return rows;
+}
+
+void GriloDataSource::addModel(GriloModel *model)
+{
+    if (d->m_models.indexOf(model) == -1) {
+        d->m_models.append(model);
+    }
+}
+
+void GriloDataSource::removeModel(GriloModel *model)
+{
+    d->m_models.removeAll(model);
+    d->m_modelFilters.remove(model);
+}
+
+void GriloDataSource::prefill(GriloModel *model)
+{
+    if (d->m_media.isEmpty()) {
+        return;
+    }
+
+    model->sourceRowsAboutToBeInserted(0, d->m_media.size() - 1);
+    model->sourceRowsInserted();
+}
+
+void GriloDataSource::addMedia(GrlMedia *media)
+{
+    if (d->sorted()) {
+        addSortedMedia(media);
+        return;
+    }
+
+    QString id = QString::fromUtf8(grl_media_get_id(media));
+    int index = -1;
+    int unmatchedPosition = -1;
+
+    // Rows left over from the previous fetch are matched by id, the first
+    // fetch has nothing to match yet.
+    if (d->m_insertIndex < d->m_media.count()) {
+        index = d->rowOf(id, &unmatchedPosition);
+
+        if (index != -1 && !d->m_pending.isEmpty()) {
+            // Rows can only be moved once everything before them is in place.
+            flushInserts();
+            index = d->rowOf(id, &unmatchedPosition);
+        }
+    }
+
+    if (index != -1) {
+        if (index < d->m_insertIndex) {
+            // Already placed by this fetch, moving it again would only shuffle the rows around.
+            qWarning() << "Duplicate id detected on qtgrilo model source, ignored to keep model sane. Id:" << id;
+            g_object_unref(media);
+            return;
+        }
+
+        // If the media was already queried by a previous fetch update its position and refresh
+        // the data instead of creating another item.
+        if (index != d->m_insertIndex) {
+            d->m_stats.count(GriloOperationStats::Moves, 1, d->m_models.count());
+            Q_FOREACH (GriloModel *model, d->m_models) {
+                model->sourceRowAboutToBeMoved(index, d->m_insertIndex);
+            }
+            std::rotate(d->m_media.begin() + d->m_insertIndex, d->m_media.begin() + index,
+                        d->m_media.begin() + index + 1);
+            d->m_mediaListValid = false;
+            Q_FOREACH (GriloModel *model, d->m_models) {
+                model->sourceRowMoved();
+            }
+        }
+
+        if (unmatchedPosition != -1) {
+            d->m_unmatched.remove(unmatchedPosition);
+        }
+
+        updateRow(d->m_insertIndex, media);
+        d->m_media[d->m_insertIndex].deferred = !d->m_deferredKeys.isEmpty();
+        d->placedAt(id, d->m_insertIndex);
+        ++d->m_insertIndex;
+        d->m_previouslyAddedId = id;
+        return;
+    }
+
+    // simple detection whether the result has duplicated ids on adjacent rows.
+    // would be nice to ensure that there are no duplicates earlier either
+    // as those can get qtgrilo quite confused / crashing, but maybe keeping
+    // track of all ids so far on an update is too much.
+    if (!id.isEmpty() && id == d->m_previouslyAddedId) {
+        qWarning() << "Duplicate id detected on qtgrilo model source, ignored to keep model sane. Id:" << id;
+        g_object_unref(media);
+        return;
+    }
+
+    GriloMediaRow row;
+    row.id = id;
+    row.deferred = !d->m_deferredKeys.isEmpty();
+    fill_row(row, media);
+    d->storeColumns(row);
+    d->m_pending.append(row);
+    d->m_previouslyAddedId = id;
+    pendingAdded();
+}
+
+void GriloDataSource::pendingAdded()
+{
+    if (d->m_pending.count() == 1) {
+        d->m_pendingSince.start();
+        if (d->m_batchInterval > 0) {
+            d->m_flushTimer.start(d->m_batchInterval, this);
+        }
+    }
+
+    if (d->m_pending.count() >= d->m_batchSize
+            || (d->m_batchInterval > 0 && d->m_pendingSince.elapsed() >= d->m_batchInterval)) {
+        flushInserts();
+    }
+}
+
+void GriloDataSource::addSortedMedia(GrlMedia *media)
+{
+    QString id = QString::fromUtf8(grl_media_get_id(media));
+    bool deferred = !d->m_deferredKeys.isEmpty();
+
+    ++d->m_insertIndex;
+
+    int index = d->rowOf(id);
+    if (index != -1) {
+        GriloMediaRow &existing = d->m_media[index];
+        if (existing.generation == d->m_generation && d->m_sweeping) {
+            qWarning() << "Duplicate id detected on qtgrilo model source, ignored to keep model sane. Id:" << id;
+            g_object_unref(media);
+            return;
+        }
+
+        existing.generation = d->m_generation;
+        existing.deferred = deferred;
+        // Moves the row if its sort keys changed
+        updateRow(index, media);
+        return;
+    }
+
+    GriloMediaRow row;
+    row.id = id;
+    row.deferred = deferred;
+    row.generation = d->m_generation;
+    fill_row(row, media);
+    // Numeric sort keys are read from the columns, as for the rows already in place.
+    d->storeColumns(row);
+    d->fillSortKeys(row);
+
+    // Placed with the rest of the batch by flushInserts()
+    d->m_pending.append(row);
+    d->m_pendingSorted = true;
+    pendingAdded();
+}
+
+void GriloDataSource::flushSortedInserts()
+{
+    // Results of the batch sharing an id, the last one wins
+    QHash<QString, int> ids;
+    for (int i = 0; i < d->m_pending.count(); ++i) {
+        GriloMediaRow &row = d->m_pending[i];
+        if (row.id.isEmpty()) {
+            continue;
+        }
+
+        QHash<QString, int>::const_iterator it = ids.constFind(row.id);
+        if (it == ids.constEnd()) {
+            ids.insert(row.id, i);
+            continue;
+        }
+
+        if (d->m_sweeping) {
+            qWarning() << "Duplicate id detected on qtgrilo model source, ignored to keep model sane. Id:" << row.id;
+        } else {
+            std::swap(d->m_pending[it.value()], row);
+        }
+        d->releaseColumns(row);
+        g_object_unref(row.media);
+        row.media = 0;
+    }
+
+    QVector<GriloMediaRow> pending;
+    pending.reserve(d->m_pending.count());
+    Q_FOREACH (const GriloMediaRow &row, d->m_pending) {
+        if (row.media) {
+            pending.append(row);
+        }
+    }
+    d->m_pending.clear();
+
+    std::stable_sort(pending.begin(), pending.end(),
+                     [this](const GriloMediaRow &left, const GriloMediaRow &right) {
+        return d->compareRows(left, right) < 0;
+    });
+
+    // Rows going between the same two rows are inserted as one range.
+    for (int first = 0; first < pending.count();) {
+        int index = d->sortedPosition(pending.at(first));
+        int last = first;
+        while (last + 1 < pending.count()
+               && (index == d->m_media.count() || d->compareRows(pending.at(last + 1), d->m_media.at(index)) < 0)) {
+            ++last;
+        }
+        int count = last - first + 1;
+
+        d->m_stats.count(GriloOperationStats::Inserts, count, d->m_models.count());
+        Q_FOREACH (GriloModel *model, d->m_models) {
+            model->sourceRowsAboutToBeInserted(index, index + count - 1);
+        }
+
+        d->m_media.insert(d->m_media.begin() + index, count, GriloMediaRow());
+        for (int i = 0; i < count; ++i) {
+            const GriloMediaRow &row = pending.at(first + i);
+            d->m_media[index + i] = row;
+            if (!row.id.isEmpty()) {
+                d->m_rows.insert(row.id, index + i);
+            }
+            d->account(row, 1);
+        }
+        // The rows after them moved, the hash catches up when looked at.
+        d->m_validRows = qMin(d->m_validRows, index);
+        d->m_mediaListValid = false;
+
+        Q_FOREACH (GriloModel *model, d->m_models) {
+            model->sourceRowsInserted();
+        }
+
+        first = last + 1;
+    }
+}
+
+int GriloDataSource::resortRow(int index)
+{
+    GriloMediaRow row = d->m_media.at(index);
+    d->fillSortKeys(row);
+    d->m_media[index] = row;
+
+    bool ordered = (index == 0 || d->compareRows(d->m_media.at(index - 1), row) <= 0)
+            && (index == d->m_media.count() - 1 || d->compareRows(row, d->m_media.at(index + 1)) <= 0);
+    if (ordered) {
+        return index;
+    }
+
+    d->m_media.remove(index);
+    int position = d->sortedPosition(row);
+    d->m_media.insert(index, row);
+
+    d->m_stats.count(GriloOperationStats::Moves, 1, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowAboutToBeMoved(index, position > index ? position + 1 : position);
+    }
+
+    d->m_media.remove(index);
+    d->m_media.insert(position, row);
+    // Only the rows in between shifted, keep the index valid for the rows
+    // of the running fetch still to be matched.
+    d->renumber(qMin(index, position), qMax(index, position));
+    d->m_mediaListValid = false;
+
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowMoved();
+    }
+
+    return position;
+}
+
+void GriloDataSource::sweepRows()
+{
+    // Rows not returned by the fetch which just completed, bottom up in ranges
+    int last = -1;
+    for (int i = d->m_media.count() - 1; i >= -1; --i) {
+        bool seen = i < 0 || d->m_media.at(i).generation == d->m_generation;
+        if (!seen && last == -1) {
+            last = i;
+        } else if (seen && last != -1) {
+            removeRows(i + 1, last);
+            last = -1;
+        }
+    }
+}
+
+QVariantList GriloDataSource::sortKeys() const
+{
+    return d->m_sortKeys;
+}
+
+void GriloDataSource::setSortKeys(const QVariantList &keys)
+{
+    if (d->m_sortKeys == keys) {
+        return;
+    }
+
+    if (d->m_opId != 0) {
+        // The rows of a running fetch are placed the old way, get them again.
+        cancelRefresh();
+        scheduleUpdate();
+    }
+    flushInserts();
+
+    d->m_sortKeys = keys;
+    d->m_sortSpec.clear();
+    Q_FOREACH (const QVariant &var, keys) {
+        int key = var.toInt();
+        if (key != 0) {
+            GriloSortSpec spec;
+            spec.key = qAbs(key);
+            spec.text = grl_metadata_key_get_type(spec.key) == G_TYPE_STRING;
+            spec.descending = key < 0;
+            d->m_sortSpec.append(spec);
+        }
+    }
+
+    if (!d->m_media.isEmpty() && !d->sparse()) {
+        // Sorted once here, later rows go to their place.
+        d->m_stats.count(GriloOperationStats::Resets, 1, d->m_models.count());
+        Q_FOREACH (GriloModel *model, d->m_models) {
+            model->sourceAboutToBeReset();
+        }
+
+        for (int i = 0; i < d->m_media.count(); ++i) {
+            d->fillSortKeys(d->m_media[i]);
+        }
+        if (d->sorted()) {
+            std::stable_sort(d->m_media.begin(), d->m_media.end(),
+                             [this](const GriloMediaRow &left, const GriloMediaRow &right) {
+                return d->compareRows(left, right) < 0;
+            });
+        }
+        d->m_validRows = 0;
+        d->m_mediaListValid = false;
+
+        Q_FOREACH (GriloModel *model, d->m_models) {
+            model->sourceReset();
+        }
+    }
+
+    Q_EMIT sortKeysChanged();
+}
+
+void GriloDataSource::updateRow(int index, GrlMedia *media)
+{
+    GriloMediaRow &row = d->m_media[index];
+    d->account(row, -1);
+
+    if (row.media != media) {
+        if (row.media) {
+            g_object_unref(row.media);
+        }
+        fill_row(row, media);
+        d->storeColumns(row);
+        if (row.wrapper) {
+            g_object_ref(media);
+            row.wrapper->setMedia(media);
+        }
+    } else {
+        // Resolved in place, only the converted values are stale.
+        g_object_unref(media);
+        fill_row(row, media);
+        d->storeColumns(row);
+        if (row.wrapper) {
+            row.wrapper->setMedia(media);
+        }
+    }
+    d->account(row, 1);
+
+    if (d->sorted()) {
+        index = resortRow(index);
+    }
+
+    d->m_stats.count(GriloOperationStats::Updates, 1, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsChanged(index, index);
+    }
+}
+
+void GriloDataSource::flushInserts()
+{
+    if (d->m_pending.isEmpty()) {
+        return;
+    }
+
+    GRILO_TRACE_SCOPE("flush");
+    d->m_flushTimer.stop();
+
+    if (d->m_pendingSorted) {
+        d->m_pendingSorted = false;
+        flushSortedInserts();
+        return;
+    }
+
+    int first = d->m_insertIndex;
+    int last = first + d->m_pending.count() - 1;
+
+    d->m_stats.count(GriloOperationStats::Inserts, last - first + 1, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsAboutToBeInserted(first, last);
+    }
+
+    if (first == d->m_media.count()) {
+        d->m_media += d->m_pending;
+    } else {
+        d->m_media.insert(d->m_media.begin() + first, d->m_pending.count(), GriloMediaRow());
+        std::copy(d->m_pending.constBegin(), d->m_pending.constEnd(), d->m_media.begin() + first);
+    }
+
+    Q_FOREACH (const GriloMediaRow &row, d->m_pending) {
+        d->placedAt(row.id, d->m_insertIndex);
+        d->account(row, 1);
+        ++d->m_insertIndex;
+    }
+
+    d->m_pending.clear();
+    d->m_mediaListValid = false;
+
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsInserted();
+    }
+}
+
+void GriloDataSource::removeMedia(GrlMedia *media)
+{
+    flushInserts();
+
+    int unmatchedPosition = -1;
+    int index = d->rowOf(QString::fromUtf8(grl_media_get_id(media)), &unmatchedPosition);
+
+    if (index == -1) {
+        // We really cannot do much.
+        return;
+    }
+
+    removeRow(index, unmatchedPosition);
+}
+
+void GriloDataSource::removeRow(int index, int unmatchedPosition)
+{
+    GriloMediaRow row = d->m_media.at(index);
+
+    if (unmatchedPosition != -1) {
+        d->m_unmatched.remove(unmatchedPosition);
+    } else {
+        if (index < d->m_insertIndex) {
+            --d->m_insertIndex;
+        }
+        d->m_validRows = qMin(d->m_validRows, index);
+    }
+
+    // remove from models:
+    d->m_stats.count(GriloOperationStats::Removals, 1, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsAboutToBeRemoved(index, index);
+    }
+
+    // remove from hash
+    d->m_rows.remove(row.id);
+
+    // remove from list
+    d->m_media.remove(index);
+    d->m_mediaListValid = false;
+
+    // destroy
+    d->account(row, -1);
+    d->releaseColumns(row);
+    g_object_unref(row.media);
+    if (row.wrapper) {
+        row.wrapper->deleteLater();
+    }
+
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsRemoved();
+    }
+}
+
+void GriloDataSource::removeRows(int first, int last)
+{
+    d->m_stats.count(GriloOperationStats::Removals, last - first + 1, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsAboutToBeRemoved(first, last);
+    }
+
+    for (int i = first; i <= last; ++i) {
+        GriloMediaRow &row = d->m_media[i];
+        d->account(row, -1);
+        d->releaseColumns(row);
+        d->m_rows.remove(row.id);
+        if (row.media) {
+            g_object_unref(row.media);
+        }
+        if (row.wrapper) {
+            row.wrapper->deleteLater();
+        }
+    }
+
+    d->m_media.erase(d->m_media.begin() + first, d->m_media.begin() + last + 1);
+    d->m_validRows = qMin(d->m_validRows, first);
+    d->m_mediaListValid = false;
+
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsRemoved();
+    }
+}
+
+int GriloDataSource::retainMatchingRows(const QString &text)
+{
+    if (d->sparse() || d->m_opId != 0) {
+        return -1;
+    }
+
+    flushInserts();
+
+    QStringMatcher matcher(text.toCaseFolded(), Qt::CaseSensitive);
+    int last = -1;
+
+    // Bottom up so that the ranges still to be removed keep their rows.
+    for (int i = d->m_media.count() - 1; i >= -1; --i) {
+        bool matches = true;
+        if (i >= 0) {
+            matches = matcher.indexIn(d->m_media.at(i).searchText) != -1;
+        }
+
+        if (!matches && last == -1) {
+            last = i;
+        } else if (matches && last != -1) {
+            removeRows(i + 1, last);
+            last = -1;
+        }
+    }
+
+    // The operation confirming the rows matches them by id.
+    d->m_previouslyAddedId.clear();
+
+    return d->m_media.count();
+}
+
+void GriloDataSource::removeMedia(GPtrArray *media)
+{
+    // Resolve all rows first and remove them bottom up so that the rows
+    // still to be removed keep valid positions.
+    flushInserts();
+
+    QVector<QPair<int, int> > rows;
+    rows.reserve(media->len);
+
+    for (uint i = 0; i < media->len; ++i) {
+        GrlMedia *item = static_cast<GrlMedia *>(g_ptr_array_index(media, i));
+        int unmatchedPosition = -1;
+        int index = d->rowOf(QString::fromUtf8(grl_media_get_id(item)), &unmatchedPosition);
+        if (index != -1) {
+            rows.append(qMakePair(index, unmatchedPosition));
+        }
+    }
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    for (int i = rows.count() - 1; i >= 0; --i) {
+        removeRow(rows.at(i).first, rows.at(i).second);
+    }
+}
+
+void GriloDataSource::clearMedia()
+{
+    Q_FOREACH (const GriloMediaRow &row, d->m_pending) {
+        g_object_unref(row.media);
+    }
+    d->m_pending.clear();
+    d->m_pendingSorted = false;
+    // Every row goes, no need to release them one by one.
+    d->m_columns.clear();
+    d->clearAggregates();
+    d->m_flushTimer.stop();
+
+    if (d->m_media.isEmpty()) {
+        return;
+    }
+
+    int size = d->m_media.size();
+
+    d->m_stats.count(GriloOperationStats::Removals, size, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsAboutToBeRemoved(0, size - 1);
+    }
+
+    Q_FOREACH (const GriloMediaRow &row, d->m_media) {
+        delete row.wrapper;
+        if (row.media) {
+            g_object_unref(row.media);
+        }
+    }
+    d->m_media.clear();
+    d->m_mediaListValid = false;
+    d->m_rows.clear();
+    d->endRefetch();
+    d->m_validRows = 0;
+    d->m_insertIndex = 0;
+
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsRemoved();
+    }
+}
+
+GriloRegistry *GriloDataSource::registry() const
+{
+    return d->m_registry;
+}
+
+void GriloDataSource::setRegistry(GriloRegistry *registry)
+{
+    // Registry change is not allowed for now.
+
+    if (!d->m_registry && registry != d->m_registry) {
+
+        d->m_registry = registry;
+
+        QObject::connect(d->m_registry, SIGNAL(availableSourcesChanged()),
+                         this, SLOT(availableSourcesChanged()));
+        QObject::connect(d->m_registry, SIGNAL(contentChanged(QString, GrlSourceChangeType, GPtrArray *, bool)),
+                         this, SLOT(sourceContentChanged(QString, GrlSourceChangeType, GPtrArray *, bool)));
+
+        Q_EMIT registryChanged();
+    }
+}
+
+int GriloDataSource::count() const
+{
+    return d->m_count;
+}
+
+void GriloDataSource::setCount(int count)
+{
+    if (d->m_count != count) {
+        d->m_count = count;
+        Q_EMIT countChanged();
+    }
+}
+
+int GriloDataSource::skip() const
+{
+    return d->m_skip;
+}
+
+void GriloDataSource::setSkip(int skip)
+{
+    if (d->m_skip != skip) {
+        d->m_skip = skip;
+        Q_EMIT skipChanged();
+    }
+}
+
+QVariantList GriloDataSource::metadataKeys() const
+{
+    return d->m_metadataKeys;
+}
+
+void GriloDataSource::setMetadataKeys(const QVariantList &keys)
+{
+    if (d->m_metadataKeys != keys) {
+        d->m_metadataKeys = keys;
+        if (d->m_columnar) {
+            d->rebuildColumns();
+        }
+        Q_EMIT metadataKeysChanged();
+    }
+}
+
+bool GriloDataSource::queueResults() const
+{
+    return d->m_queueResults;
+}
+
+void GriloDataSource::setQueueResults(bool queue)
+{
+    if (d->m_queueResults != queue) {
+        d->m_queueResults = queue;
+        if (!queue) {
+            drainResults(-1);
+        }
+        Q_EMIT queueResultsChanged();
+    }
+}
+
+int GriloDataSource::drainBudget() const
+{
+    return d->m_drainBudget;
+}
+
+void GriloDataSource::setDrainBudget(int budget)
+{
+    budget = qMax(0, budget);
+
+    if (d->m_drainBudget != budget) {
+        d->m_drainBudget = budget;
+        Q_EMIT drainBudgetChanged();
+    }
+}
+
+int GriloDataSource::queueDepth() const
+{
+    return d->m_queue.count();
+}
+
+void GriloDataSource::setViewport(int first, int last)
+{
+    // Results arrive in row order, all rows up to the last shown are needed.
+    Q_UNUSED(first)
+    d->m_viewportLast = last;
+}
+
+qint64 GriloDataSource::totalDuration() const
+{
+    return d->m_totalDuration;
+}
+
+qint64 GriloDataSource::totalSize() const
+{
+    return d->m_totalSize;
+}
+
+QVariantMap GriloDataSource::mediaTypeCounts() const
+{
+    QVariantMap counts;
+    for (QHash<int, int>::const_iterator it = d->m_typeCounts.constBegin(); it != d->m_typeCounts.constEnd(); ++it) {
+        counts.insert(media_type_name(it.key()), it.value());
+    }
+    return counts;
+}
+
+QVariantMap GriloDataSource::genreCounts() const
+{
+    QVariantMap counts;
+    for (QHash<QString, int>::const_iterator it = d->m_genreCounts.constBegin(); it != d->m_genreCounts.constEnd(); ++it) {
+        counts.insert(it.key(), it.value());
+    }
+    return counts;
+}
+
+bool GriloDataSource::columnar() const
+{
+    return d->m_columnar;
+}
+
+void GriloDataSource::setColumnar(bool columnar)
+{
+    if (d->m_columnar != columnar) {
+        d->m_columnar = columnar;
+        d->rebuildColumns();
+        Q_EMIT columnarChanged();
+    }
+}
+
+QVariantList GriloDataSource::typeFilter() const
+{
+    return d->m_typeFilter;
+}
+
+void GriloDataSource::setTypeFilter(const QVariantList &filter)
+{
+    if (d->m_typeFilter != filter) {
+        d->m_typeFilter = filter;
+        Q_EMIT typeFilterChanged();
+    }
+}
+
+int GriloDataSource::batchSize() const
+{
+    return d->m_batchSize;
+}
+
+void GriloDataSource::setBatchSize(int size)
+{
+    size = qMax(1, size);
+
+    if (d->m_batchSize != size) {
+        d->m_batchSize = size;
+        Q_EMIT batchSizeChanged();
+    }
+}
+
+int GriloDataSource::batchInterval() const
+{
+    return d->m_batchInterval;
 }
 
+void GriloDataSource::setBatchInterval(int interval)
+{
+    interval = qMax(0, interval);
 
-class GriloDataSourcePrivate
+    if (d->m_batchInterval != interval) {
+        d->m_batchInterval = interval;
+        Q_EMIT batchIntervalChanged();
+    }
+}
+
+bool GriloDataSource::incrementalUpdates() const
 {
-public:
-    GriloDataSourcePrivate();
+    return d->m_incrementalUpdates;
+}
 
-    guint m_opId;
-    GriloRegistry *m_registry;
+void GriloDataSource::setIncrementalUpdates(bool incremental)
+{
+    if (d->m_incrementalUpdates != incremental) {
+        d->m_incrementalUpdates = incremental;
+        Q_EMIT incrementalUpdatesChanged();
+    }
+}
 
-    int m_count;
-    int m_skip;
-    int m_insertIndex;
-    QVariantList m_metadataKeys;
-    QVariantList m_typeFilter;
+int GriloDataSource::resolution() const
+{
+    return d->m_resolution;
+}
 
-    bool m_updateScheduled;
-    QBasicTimer m_updateTimer;
-    QList<GriloMedia *> m_media;
-    QList<GriloModel *> m_models;
-    QHash<QString, GriloMedia *> m_hash;
-    bool m_fetching;
-    bool m_initialFetchDone = false;
-    QString m_previouslyAddedId;
-};
+void GriloDataSource::setResolution(int resolution)
+{
+    if (d->m_resolution != resolution) {
+        d->m_resolution = resolution;
+        Q_EMIT resolutionChanged();
+    }
+}
 
-GriloDataSourcePrivate::GriloDataSourcePrivate()
-    : m_opId(0)
-    , m_registry(nullptr)
-    , m_count(0)
-    , m_skip(0)
-    , m_insertIndex(0)
-    , m_updateScheduled(false)
-    , m_fetching(false)
+bool GriloDataSource::deferSlowKeys() const
 {
-    m_metadataKeys << GriloDataSource::Title;
-    m_typeFilter << GriloDataSource::None;
+    return d->m_deferSlowKeys;
 }
 
-GriloDataSource::GriloDataSource(QObject *parent)
-    : QObject(parent)
-    , d(new GriloDataSourcePrivate)
+void GriloDataSource::setDeferSlowKeys(bool defer)
 {
+    if (d->m_deferSlowKeys != defer) {
+        d->m_deferSlowKeys = defer;
+        Q_EMIT deferSlowKeysChanged();
+    }
 }
 
-GriloDataSource::~GriloDataSource()
+int GriloDataSource::pageSize() const
 {
-    cancelRefresh();
-    d->m_models.clear();
-    delete d;
+    return d->m_pageSize;
 }
 
-const QList<GriloMedia *> *GriloDataSource::media() const
+void GriloDataSource::setPageSize(int size)
 {
-    return &d->m_media;
+    size = qMax(0, size);
+
+    if (d->m_pageSize != size) {
+        bool wasSparse = d->sparse();
+        d->m_pageSize = size;
+        if (wasSparse || d->sparse()) {
+            resetPages();
+        }
+        Q_EMIT pageSizeChanged();
+    }
 }
 
-void GriloDataSource::addModel(GriloModel *model)
+int GriloDataSource::totalCount() const
 {
-    if (d->m_models.indexOf(model) == -1) {
-        d->m_models.append(model);
+    return d->m_totalCount;
+}
+
+void GriloDataSource::setTotalCount(int count)
+{
+    count = qMax(0, count);
+
+    if (d->m_totalCount != count) {
+        bool wasSparse = d->sparse();
+        d->m_totalCount = count;
+        if (wasSparse || d->sparse()) {
+            resetPages();
+        }
+        Q_EMIT totalCountChanged();
     }
 }
 
-void GriloDataSource::removeModel(GriloModel *model)
+int GriloDataSource::maxResidentPages() const
+{
+    return d->m_maxResidentPages;
+}
+
+void GriloDataSource::setMaxResidentPages(int pages)
 {
-    if (int index = d->m_models.indexOf(model) != -1) {
-        d->m_models.removeAt(index);
+    pages = qMax(0, pages);
+
+    if (d->m_maxResidentPages != pages) {
+        d->m_maxResidentPages = pages;
+        evictPages();
+        Q_EMIT maxResidentPagesChanged();
     }
 }
 
-void GriloDataSource::prefill(GriloModel *model)
+void GriloDataSource::resetPages()
 {
-    if (d->m_media.isEmpty()) {
+    cancelRefresh();
+    clearMedia();
+
+    d->m_residentPages.clear();
+    d->m_stalePages.clear();
+    d->m_pageQueue.clear();
+    d->m_fetchingPage = -1;
+    d->m_lastPage = 0;
+
+    if (!d->sparse()) {
         return;
     }
 
-    model->beginInsertRows(QModelIndex(), 0, d->m_media.size() - 1);
-    model->endInsertRows();
+    d->m_stats.count(GriloOperationStats::Inserts, d->m_totalCount, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsAboutToBeInserted(0, d->m_totalCount - 1);
+    }
+
+    d->m_media.resize(d->m_totalCount);
+    // Rows never move, every id in the hash is valid.
+    d->m_validRows = d->m_totalCount;
+    d->m_mediaListValid = false;
+
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsInserted();
+    }
 }
 
-void GriloDataSource::addMedia(GrlMedia *media)
+void GriloDataSource::requestPage(int page)
 {
-    GriloMedia *wrappedMedia = 0;
+    d->m_lastPage = page;
 
-    if (d->m_insertIndex < d->m_media.count()) {
-        wrappedMedia = d->m_hash.value(QString::fromUtf8(grl_media_get_id(media)), 0);
+    if (page == d->m_fetchingPage && d->m_opId != 0) {
+        return;
     }
 
-    // on first fetch we should be sure that there's nothing to move yet.
-    // TODO: figure out a way to avoid QList::indexOf() with each row on an update
-    if (!d->m_initialFetchDone && wrappedMedia) {
-        // If the media was already queried by a previous fetch update its position and refresh
-        // the data instead of creating another item.
-        bool dataChanged = false;
-        int index = d->m_media.indexOf(wrappedMedia);
-        if (index == d->m_insertIndex) {
-            dataChanged = true;
-        } else if (index != -1) {
-            dataChanged = true;
-            Q_FOREACH (GriloModel *model, d->m_models) {
-                model->beginMoveRows(QModelIndex(), index, index, QModelIndex(), d->m_insertIndex);
-            }
-            d->m_media.move(index, d->m_insertIndex);
-            Q_FOREACH (GriloModel *model, d->m_models) {
-                model->endMoveRows();
-            }
+    if (d->m_residentPages.contains(page) && !d->m_stalePages.contains(page)) {
+        return;
+    }
+
+    d->m_pageQueue.removeOne(page);
+    d->m_pageQueue.append(page);
+
+    // Scrolled past, those get requested again when they come back into view.
+    while (d->m_maxResidentPages > 0 && d->m_pageQueue.count() > d->m_maxResidentPages) {
+        d->m_pageQueue.removeFirst();
+    }
+
+    if (d->m_opId == 0) {
+        startNextPage();
+    }
+}
+
+bool GriloDataSource::startNextPage()
+{
+    while (!d->m_pageQueue.isEmpty()) {
+        int page = d->m_pageQueue.takeLast();
+        if (d->m_residentPages.contains(page) && !d->m_stalePages.contains(page)) {
+            continue;
         }
 
-        if (dataChanged) {
-            wrappedMedia->setMedia(media);
-            Q_FOREACH (GriloModel *model, d->m_models) {
-                QModelIndex modelIndex = model->index(d->m_insertIndex, 0);
-                model->dataChanged(modelIndex, modelIndex);
-            }
-            ++d->m_insertIndex;
-            d->m_previouslyAddedId = wrappedMedia->id();
-            return;
+        d->m_fetchingPage = page;
+        d->m_pageOffset = page * d->m_pageSize;
+        d->m_pageCount = qMin(d->m_pageSize, d->m_totalCount - d->m_pageOffset);
+        d->m_pageResults = 0;
+        d->m_insertIndex = d->m_pageOffset;
+
+        if (startOperation()) {
+            return true;
         }
+
+        d->m_fetchingPage = -1;
+        return false;
     }
 
-    wrappedMedia = new GriloMedia(media, this);
-    QString id = wrappedMedia->id();
+    return false;
+}
 
-    // simple detection whether the result has duplicated ids on adjacent rows.
-    // would be nice to ensure that there are no duplicates earlier either
-    // as those can get qtgrilo quite confused / crashing, but maybe keeping
-    // track of all ids so far on an update is too much.
-    if (!id.isEmpty() && id == d->m_previouslyAddedId) {
-        qWarning() << "Duplicate id detected on qtgrilo model source, ignored to keep model sane. Id:" << id;
-        delete wrappedMedia;
+void GriloDataSource::setPageRow(int index, GrlMedia *media)
+{
+    GriloMediaRow &row = d->m_media[index];
+    QString id = QString::fromUtf8(grl_media_get_id(media));
+
+    if (row.id != id) {
+        if (!row.id.isEmpty() && d->m_rows.value(row.id, -1) == index) {
+            d->m_rows.remove(row.id);
+        }
+        row.id = id;
+        if (!id.isEmpty()) {
+            d->m_rows.insert(id, index);
+        }
+    }
+
+    row.deferred = !d->m_deferredKeys.isEmpty();
+    updateRow(index, media);
+}
+
+void GriloDataSource::finishPage(bool failed)
+{
+    int page = d->m_fetchingPage;
+    d->m_fetchingPage = -1;
+
+    if (!failed && page != -1) {
+        // Whatever the source did not return any more is gone.
+        if (d->m_pageResults < d->m_pageCount) {
+            clearRows(d->m_pageOffset + d->m_pageResults, d->m_pageOffset + d->m_pageCount - 1);
+        }
+
+        d->m_stalePages.remove(page);
+        if (!d->m_residentPages.contains(page)) {
+            d->m_residentPages.append(page);
+        }
+        evictPages();
+    }
+}
+
+void GriloDataSource::evictPages()
+{
+    if (!d->sparse()) {
         return;
     }
 
-    Q_FOREACH (GriloModel *model, d->m_models) {
-        model->beginInsertRows(QModelIndex(), d->m_insertIndex, d->m_insertIndex);
+    while (d->m_maxResidentPages > 0 && d->m_residentPages.count() > d->m_maxResidentPages) {
+        // Drop the page furthest away from the last accessed one.
+        int furthest = 0;
+        for (int i = 1; i < d->m_residentPages.count(); ++i) {
+            if (qAbs(d->m_residentPages.at(i) - d->m_lastPage)
+                    > qAbs(d->m_residentPages.at(furthest) - d->m_lastPage)) {
+                furthest = i;
+            }
+        }
+
+        int page = d->m_residentPages.takeAt(furthest);
+        d->m_stalePages.remove(page);
+
+        int first = page * d->m_pageSize;
+        clearRows(first, qMin(first + d->m_pageSize, d->m_media.count()) - 1);
     }
+}
 
-    d->m_media.insert(d->m_insertIndex, wrappedMedia);
-    ++d->m_insertIndex;
+void GriloDataSource::clearRows(int first, int last)
+{
+    if (first > last) {
+        return;
+    }
 
-    if (!id.isEmpty()) {
-        d->m_hash.insert(id, wrappedMedia);
+    for (int i = first; i <= last; ++i) {
+        GriloMediaRow &row = d->m_media[i];
+        if (!row.media) {
+            continue;
+        }
+
+        if (!row.id.isEmpty() && d->m_rows.value(row.id, -1) == i) {
+            d->m_rows.remove(row.id);
+        }
+        if (row.wrapper) {
+            row.wrapper->deleteLater();
+        }
+        d->account(row, -1);
+        d->releaseColumns(row);
+        g_object_unref(row.media);
+        row = GriloMediaRow();
     }
 
+    d->m_mediaListValid = false;
+
+    d->m_stats.count(GriloOperationStats::Updates, last - first + 1, d->m_models.count());
     Q_FOREACH (GriloModel *model, d->m_models) {
-        model->endInsertRows();
+        model->sourceRowsChanged(first, last);
     }
+}
 
-    d->m_previouslyAddedId = id;
+bool GriloDataSource::canFetchMore() const
+{
+    return d->m_moreAvailable && d->m_opId == 0;
 }
 
-void GriloDataSource::removeMedia(GrlMedia *media)
+bool GriloDataSource::fetchMore()
 {
-    QString id = QString::fromUtf8(grl_media_get_id(media));
+    if (!canFetchMore()) {
+        return false;
+    }
 
-    if (id.isEmpty() || !d->m_hash.contains(id)) {
-        // We really cannot do much.
+    flushInserts();
+
+    // Append the next page after the rows we have, leaving those alone.
+    d->m_insertIndex = d->m_media.count();
+    d->m_pageOffset = d->m_media.count();
+    d->m_pageCount = d->m_pageSize;
+    if (d->m_count != 0) {
+        d->m_pageCount = qMin(d->m_pageCount, d->m_count - d->m_media.count());
+    }
+    d->m_pageResults = 0;
+    d->m_moreAvailable = false;
+    d->m_previouslyAddedId.clear();
+
+    return startOperation();
+}
+
+bool GriloDataSource::startOperation()
+{
+    return false;
+}
+
+void GriloDataSource::cancelOperation()
+{
+    grl_operation_cancel(d->m_opId);
+}
+
+void GriloDataSource::insertMedia(int index, GrlMedia *media)
+{
+    d->m_stats.result();
+
+    if (d->sorted()) {
+        // Sorting wins over the order asked for
+        addSortedMedia(media);
         return;
     }
 
-    GriloMedia *wrapper = d->m_hash[id];
-    int index = d->m_media.indexOf(wrapper);
-    if (index < d->m_insertIndex) {
-        --d->m_insertIndex;
+    flushInserts();
+
+    GriloMediaRow row;
+    row.id = QString::fromUtf8(grl_media_get_id(media));
+    fill_row(row, media);
+    d->storeColumns(row);
+    d->account(row, 1);
+
+    d->m_stats.count(GriloOperationStats::Inserts, 1, d->m_models.count());
+    Q_FOREACH (GriloModel *model, d->m_models) {
+        model->sourceRowsAboutToBeInserted(index, index);
     }
 
-    // remove from models:
+    d->m_media.insert(index, row);
+    // The rows after it moved, the hash catches up when looked at.
+    d->m_validRows = qMin(d->m_validRows, index);
+    d->m_insertIndex = d->m_media.count();
+    d->m_mediaListValid = false;
+
     Q_FOREACH (GriloModel *model, d->m_models) {
-        model->beginRemoveRows(QModelIndex(), index, index);
+        model->sourceRowsInserted();
     }
+}
 
-    // remove from hash
-    d->m_hash.take(id);
+void GriloDataSource::mergeMedia(GrlMedia *media, quint32 keyId, qint64 order)
+{
+    if (d->sorted()) {
+        insertMedia(0, media);
+        return;
+    }
 
-    // remove from list
-    d->m_media.takeAt(index);
+    flushInserts();
 
-    // destroy
-    wrapper->deleteLater();
+    // Only the merge keys, the row itself is built by insertMedia()
+    GriloMediaRow row;
+    row.media = media;
 
-    Q_FOREACH (GriloModel *model, d->m_models) {
-        model->endRemoveRows();
+    bool missing = keyId == 0 || !grl_data_has_key(GRL_DATA(media), keyId);
+    row.numberKeys.append(missing ? 1 : 0);
+    if (!missing) {
+        GriloSortSpec spec;
+        spec.key = keyId;
+        spec.text = grl_metadata_key_get_type(keyId) == G_TYPE_STRING;
+        spec.descending = false;
+        d->appendSortKey(row, spec);
+    }
+    row.numberKeys.append(order);
+
+    // After the rows comparing equal, like sortedPosition()
+    int first = 0;
+    int last = d->m_media.count();
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+        if (d->compareMerged(d->m_media.at(middle), row) <= 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
     }
+
+    insertMedia(first, media);
+    d->m_media[first].textKeys.swap(row.textKeys);
+    d->m_media[first].numberKeys.swap(row.numberKeys);
 }
 
-void GriloDataSource::clearMedia()
+void GriloDataSource::finishOperation(bool failed)
 {
-    if (d->m_media.isEmpty()) {
-        return;
+    d->m_insertIndex = d->m_media.count();
+    addResult(0, 0, failed);
+}
+
+bool GriloDataSource::diskCache() const
+{
+    return d->m_diskCache;
+}
+
+void GriloDataSource::setDiskCache(bool enabled)
+{
+    if (d->m_diskCache != enabled) {
+        d->m_diskCache = enabled;
+        Q_EMIT diskCacheChanged();
+    }
+}
+
+QString GriloDataSource::operationKey() const
+{
+    return QString();
+}
+
+QString GriloDataSource::cacheKey() const
+{
+    QString key = operationKey();
+    if (key.isEmpty()) {
+        return QString();
+    }
+
+    Q_FOREACH (const QVariant &var, d->m_metadataKeys) {
+        key += QLatin1Char(',') + QString::number(var.toInt());
+    }
+    key += QString::fromLatin1("|%1|%2|%3|%4|%5|%6").arg(d->typeFilterFlags()).arg(d->m_skip)
+            .arg(d->m_count).arg(d->m_pageSize).arg(d->m_resolution).arg(d->m_deferSlowKeys);
+
+    return key;
+}
+
+QString GriloDataSource::cacheFilePath() const
+{
+    QString key = d->m_diskCache ? cacheKey() : QString();
+    if (key.isEmpty()) {
+        return QString();
+    }
+
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + QLatin1String("/grilo-qt");
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    return dir + QLatin1Char('/') + QString::fromLatin1(hash);
+}
+
+bool GriloDataSource::sharedResults() const
+{
+    return d->m_sharedResults;
+}
+
+void GriloDataSource::setSharedResults(bool shared)
+{
+    if (d->m_sharedResults != shared) {
+        d->m_sharedResults = shared;
+        Q_EMIT sharedResultsChanged();
+    }
+}
+
+int GriloDataSource::sharedResultsLimit()
+{
+    return resultCache()->limit();
+}
+
+void GriloDataSource::setSharedResultsLimit(int rows)
+{
+    resultCache()->setLimit(qMax(0, rows));
+}
+
+int GriloDataSource::refreshDelay() const
+{
+    return d->m_refreshDelay;
+}
+
+void GriloDataSource::setRefreshDelay(int delay)
+{
+    delay = qMax(0, delay);
+
+    if (d->m_refreshDelay != delay) {
+        d->m_refreshDelay = delay;
+        Q_EMIT refreshDelayChanged();
+    }
+}
+
+int GriloDataSource::refreshMaxWait() const
+{
+    return d->m_refreshMaxWait;
+}
+
+void GriloDataSource::setRefreshMaxWait(int wait)
+{
+    wait = qMax(0, wait);
+
+    if (d->m_refreshMaxWait != wait) {
+        d->m_refreshMaxWait = wait;
+        Q_EMIT refreshMaxWaitChanged();
+    }
+}
+
+int GriloDataSource::avoidedOperations() const
+{
+    return d->m_avoidedOperations;
+}
+
+bool GriloDataSource::deferRefresh()
+{
+    if (d->m_refreshing) {
+        // The delayed refresh itself
+        return false;
+    }
+
+    // Paged data sources run several operations with the same key.
+    QString key = d->m_pageSize > 0 ? QString() : cacheKey();
+
+    if (d->m_refreshDelay == 0) {
+        // Every refresh() restarts the operation, as without debouncing.
+        d->m_refreshKey = key;
+        d->m_refreshTimer.stop();
+        return false;
+    }
+
+    bool pending = d->m_refreshTimer.isActive();
+
+    if (!key.isEmpty() && key == d->m_refreshKey && (pending || d->m_opId != 0)) {
+        // Asking again for what is on its way already
+        ++d->m_avoidedOperations;
+        Q_EMIT avoidedOperationsChanged();
+        return true;
+    }
+
+    d->m_refreshKey = key;
+
+    if (pending) {
+        // Replaces the refresh waiting for the quiet period
+        ++d->m_avoidedOperations;
+        Q_EMIT avoidedOperationsChanged();
+    } else {
+        d->m_refreshPendingSince.start();
+    }
+
+    int delay = d->m_refreshDelay;
+    if (d->m_refreshMaxWait > 0) {
+        delay = int(qBound<qint64>(0, d->m_refreshMaxWait - d->m_refreshPendingSince.elapsed(), delay));
+    }
+    d->m_refreshTimer.start(delay, this);
+
+    return true;
+}
+
+bool GriloDataSource::followSharedResults()
+{
+    if (!d->m_sharedResults || d->m_pageSize > 0) {
+        return false;
     }
 
-    int size = d->m_media.size();
+    QString key = cacheKey();
+    GriloSharedResults *shared = key.isEmpty() ? 0 : resultCache()->acquire(key);
+    if (!shared) {
+        return false;
+    }
 
-    Q_FOREACH (GriloModel *model, d->m_models) {
-        model->beginRemoveRows(QModelIndex(), 0, size - 1);
+    d->m_shared = shared;
+    // Operations deferring keys are not shared, see setOpId().
+    d->m_deferredKeys.clear();
+    d->m_deferredSource.clear();
+    if (shared->owner) {
+        shared->followers.append(this);
     }
 
-    qDeleteAll(d->m_media);
-    d->m_media.clear();
-    d->m_hash.clear();
+    setFetching(true);
 
-    Q_FOREACH (GriloModel *model, d->m_models) {
-        model->endRemoveRows();
+    // Replay what is there so far, a running operation feeds the rest.
+    int count = shared->media.count();
+    if (count == 0 && !shared->owner) {
+        addResult(0, 0, false);
+    }
+    for (int i = 0; i < count; ++i) {
+        g_object_ref(shared->media.at(i));
+        addResult(shared->media.at(i), shared->owner ? 1 : count - i - 1, false);
     }
-}
 
-GriloRegistry *GriloDataSource::registry() const
-{
-    return d->m_registry;
+    return true;
 }
 
-void GriloDataSource::setRegistry(GriloRegistry *registry)
+bool GriloDataSource::loadCache()
 {
-    // Registry change is not allowed for now.
+    // Only fills an empty model, the fetch started next matches the rows by id.
+    if (d->m_initialFetchDone || !d->m_media.isEmpty() || d->sparse()) {
+        return false;
+    }
 
-    if (!d->m_registry && registry != d->m_registry) {
+    QString path = cacheFilePath();
+    if (path.isEmpty()) {
+        return false;
+    }
 
-        d->m_registry = registry;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
 
-        QObject::connect(d->m_registry, SIGNAL(availableSourcesChanged()),
-                         this, SLOT(availableSourcesChanged()));
-        QObject::connect(d->m_registry, SIGNAL(contentChanged(QString, GrlSourceChangeType, GPtrArray *)),
-                         this, SLOT(contentChanged(QString, GrlSourceChangeType, GPtrArray *)));
+    qint64 size = file.size();
+    const uchar *data = size >= 12 ? file.map(0, size) : 0;
+    if (!data) {
+        return false;
+    }
 
-        Q_EMIT registryChanged();
+    quint32 version;
+    quint32 count;
+    memcpy(&version, data + 4, sizeof(version));
+    memcpy(&count, data + 8, sizeof(count));
+    if (memcmp(data, cacheMagic, 4) != 0 || version != cacheVersion) {
+        qWarning() << "Ignoring invalid result cache" << path;
+        return false;
     }
-}
 
-int GriloDataSource::count() const
-{
-    return d->m_count;
-}
+    d->m_insertIndex = 0;
+    d->m_previouslyAddedId.clear();
+
+    qint64 offset = 12;
+    for (quint32 i = 0; i < count && offset + 4 <= size; ++i) {
+        quint32 length;
+        memcpy(&length, data + offset, sizeof(length));
+        offset += 4;
+        if (offset + length > size) {
+            break;
+        }
 
-void GriloDataSource::setCount(int count)
-{
-    if (d->m_count != count) {
-        d->m_count = count;
-        Q_EMIT countChanged();
+        QByteArray serialized(reinterpret_cast<const char *>(data + offset), length);
+        offset += length;
+
+        GrlMedia *media = grl_media_unserialize(serialized.constData());
+        if (media) {
+            addMedia(media);
+        }
     }
-}
 
-int GriloDataSource::skip() const
-{
-    return d->m_skip;
+    flushInserts();
+    d->m_insertIndex = 0;
+    d->m_previouslyAddedId.clear();
+
+    return !d->m_media.isEmpty();
 }
 
-void GriloDataSource::setSkip(int skip)
+void GriloDataSource::saveCache()
 {
-    if (d->m_skip != skip) {
-        d->m_skip = skip;
-        Q_EMIT skipChanged();
+    QString path = cacheFilePath();
+    if (path.isEmpty()) {
+        return;
     }
-}
 
-QVariantList GriloDataSource::metadataKeys() const
-{
-    return d->m_metadataKeys;
-}
+    // Serialized here while the media is ours, written and synced in the background.
+    quint32 count = 0;
+    QByteArray data;
+    data.append(cacheMagic, 4);
+    data.append(reinterpret_cast<const char *>(&cacheVersion), sizeof(cacheVersion));
+    data.append(reinterpret_cast<const char *>(&count), sizeof(count));
+
+    Q_FOREACH (const GriloMediaRow &row, d->m_media) {
+        gchar *serialized = row.media ? grl_media_serialize_extended(row.media, GRL_MEDIA_SERIALIZE_FULL) : 0;
+        if (!serialized) {
+            continue;
+        }
 
-void GriloDataSource::setMetadataKeys(const QVariantList &keys)
-{
-    if (d->m_metadataKeys != keys) {
-        d->m_metadataKeys = keys;
-        Q_EMIT metadataKeysChanged();
+        quint32 length = qstrlen(serialized);
+        data.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        data.append(serialized, length);
+        g_free(serialized);
+        ++count;
     }
-}
 
-QVariantList GriloDataSource::typeFilter() const
-{
-    return d->m_typeFilter;
-}
+    memcpy(data.data() + 8, &count, sizeof(count));
 
-void GriloDataSource::setTypeFilter(const QVariantList &filter)
-{
-    if (d->m_typeFilter != filter) {
-        d->m_typeFilter = filter;
-        Q_EMIT typeFilterChanged();
-    }
+    cacheWriter()->start(new GriloCacheWrite(path, data));
 }
 
 bool GriloDataSource::fetching() const
@@ -322,10 +3080,24 @@ void GriloDataSource::setFetching(bool fetching)
 {
     if (fetching != d->m_fetching) {
         d->m_fetching = fetching;
+
+        if (fetching) {
+            d->m_stats.start();
+        } else {
+            d->m_lastStats = d->m_stats.toMap();
+            qCDebug(lcOperation) << metaObject()->className() << objectName() << d->m_lastStats;
+            Q_EMIT statsChanged();
+        }
+
         Q_EMIT fetchingChanged();
     }
 }
 
+QVariantMap GriloDataSource::stats() const
+{
+    return d->m_lastStats;
+}
+
 GrlOperationOptions *GriloDataSource::operationOptions(GrlSource *src, const OperationType &type)
 {
     GrlCaps *caps = NULL;
@@ -336,49 +3108,180 @@ GrlOperationOptions *GriloDataSource::operationOptions(GrlSource *src, const Ope
 
     GrlOperationOptions *options = grl_operation_options_new(caps);
 
-    grl_operation_options_set_resolution_flags(options, GRL_RESOLVE_IDLE_RELAY); // TODO: hardcoded
-    grl_operation_options_set_skip(options, d->m_skip);
-
-    if (d->m_count != 0) {
-        grl_operation_options_set_count(options, d->m_count);
-    }
+    grl_operation_options_set_resolution_flags(options, (GrlResolutionFlags)d->m_resolution);
+    grl_operation_options_set_skip(options, d->m_skip + d->m_pageOffset);
 
-    int typeFilter = 0;
-    Q_FOREACH (const QVariant &var, d->m_typeFilter) {
-        if (var.canConvert<int>()) {
-            typeFilter |= var.toInt();
-        }
+    int count = d->m_pageSize > 0 ? d->m_pageCount : d->m_count;
+    if (count != 0) {
+        grl_operation_options_set_count(options, count);
     }
 
-    grl_operation_options_set_type_filter(options, (GrlTypeFilter)typeFilter);
+    grl_operation_options_set_type_filter(options, (GrlTypeFilter)d->typeFilterFlags());
 
     return options;
 }
 
-GList *GriloDataSource::keysAsList()
+GList *GriloDataSource::keysAsList(GrlSource *src)
 {
     // TODO: Check why using  grl_metadata_key_list_new() produces a symbol error.
     GList *keys = NULL;
+    const GList *slowKeys = NULL;
+
+    if (src) {
+        // Keys for a new operation, decide what gets deferred this time.
+        d->m_deferredKeys.clear();
+        d->m_deferredSource.clear();
+
+        d->m_operationSource = QString::fromUtf8(grl_source_get_id(src));
+        if (d->m_deferSlowKeys) {
+            slowKeys = grl_source_slow_keys(src);
+            d->m_deferredSource = d->m_operationSource;
+        }
+    }
 
     Q_FOREACH (const QVariant &var, d->m_metadataKeys) {
         if (var.canConvert<int>()) {
-            keys = g_list_append(keys, GRLKEYID_TO_POINTER(var.toInt()));
+            int key = var.toInt();
+            if (slowKeys && g_list_find(const_cast<GList *>(slowKeys), GRLKEYID_TO_POINTER(key))) {
+                d->m_deferredKeys.append(key);
+            } else {
+                keys = g_list_append(keys, GRLKEYID_TO_POINTER(key));
+            }
         }
     }
 
     return keys;
 }
 
+void GriloDataSource::resolveQueuedKeys()
+{
+    d->m_deferredTimer.stop();
+
+    // Only a few rows at a time, the most recently accessed first.
+    while (!d->m_deferredQueue.isEmpty() && d->m_deferredOps.count() < maxDeferredOps) {
+        int index = d->rowOf(d->m_deferredQueue.takeLast());
+        if (index != -1) {
+            resolveDeferredKeys(index);
+        }
+    }
+}
+
+void GriloDataSource::resolveDeferredKeys(int index)
+{
+    GriloMediaRow &row = d->m_media[index];
+
+    GrlSource *src = d->m_registry ? d->m_registry->lookupSource(d->m_deferredSource) : 0;
+    if (!src) {
+        return;
+    }
+
+    GList *keys = NULL;
+    Q_FOREACH (int key, d->m_deferredKeys) {
+        keys = g_list_append(keys, GRLKEYID_TO_POINTER(key));
+    }
+
+    GrlOperationOptions *options = operationOptions(src, Resolve);
+    int flags = (d->m_resolution & ~GRL_RESOLVE_FAST_ONLY) | GRL_RESOLVE_IDLE_RELAY;
+    grl_operation_options_set_resolution_flags(options, (GrlResolutionFlags)flags);
+
+    g_object_ref(row.media);
+    guint opId = grl_source_resolve(src, row.media, keys, options, grilo_deferred_keys_cb, this);
+    if (opId != 0) {
+        d->m_deferredOps.append(opId);
+    }
+
+    g_object_unref(options);
+    g_list_free(keys);
+}
+
+void GriloDataSource::grilo_deferred_keys_cb(GrlSource *source, guint op_id, GrlMedia *media,
+                                             gpointer user_data, const GError *error)
+{
+    Q_UNUSED(source)
+
+    if (error) {
+        if (error->domain != GRL_CORE_ERROR || error->code != GRL_CORE_ERROR_OPERATION_CANCELLED) {
+            qWarning() << "Resolving slow keys failed" << error->message;
+        } else {
+            // Cancelled, the instance might be deleted already
+            g_object_unref(media);
+            return;
+        }
+    }
+
+    GriloDataSource *that = static_cast<GriloDataSource *>(user_data);
+    that->d->m_deferredOps.removeOne(op_id);
+
+    int index = that->d->rowOf(QString::fromUtf8(grl_media_get_id(media)));
+    if (!error && index != -1 && that->d->m_media.at(index).media == media) {
+        that->updateRow(index, media);
+    } else {
+        g_object_unref(media);
+    }
+
+    that->resolveQueuedKeys();
+}
+
 void GriloDataSource::cancelRefresh()
 {
+    stopOperation();
+    d->m_refreshTimer.stop();
+}
+
+void GriloDataSource::stopOperation()
+{
+    // Rows received so far stay in the model like they would have without batching.
+    drainResults(-1);
+    flushInserts();
+
     if (d->m_opId != 0) {
-        grl_operation_cancel(d->m_opId);
+        cancelOperation();
         d->m_previouslyAddedId.clear();
         d->m_opId = 0;
+        // The operation replacing it is counted on its own.
+        d->m_stats.start();
+    }
+
+    if (d->m_shared) {
+        GriloSharedResults *shared = d->m_shared;
+        d->m_shared = 0;
+        resultCache()->release(shared, this);
     }
 
+    // A refresh brings the changed items along anyway.
+    Q_FOREACH (guint opId, d->m_resolveOps + d->m_deferredOps) {
+        grl_operation_cancel(opId);
+    }
+    d->m_resolveOps.clear();
+    d->m_deferredOps.clear();
+    d->m_deferredQueue.clear();
+    d->m_deferredTimer.stop();
+
     d->m_insertIndex = 0;
+    d->endRefetch();
+    d->m_sweeping = false;
     d->m_updateScheduled = false;
+
+    // A refresh fetches again everything paged in so far.
+    d->m_pageOffset = 0;
+    d->m_pageCount = qMax(d->m_pageSize, d->m_media.count());
+    if (d->m_count != 0) {
+        d->m_pageCount = qMin(d->m_pageCount, d->m_count);
+    }
+    d->m_pageResults = 0;
+    d->m_moreAvailable = false;
+
+    d->m_pageQueue.clear();
+    d->m_fetchingPage = -1;
+    if (d->sparse()) {
+        // The next operation refetches the page last accessed, the other
+        // pages are refetched when they get accessed again.
+        d->m_stalePages = QSet<int>::fromList(d->m_residentPages);
+        d->m_fetchingPage = qBound(0, d->m_lastPage, (d->m_totalCount - 1) / d->m_pageSize);
+        d->m_pageOffset = d->m_fetchingPage * d->m_pageSize;
+        d->m_pageCount = qMin(d->m_pageSize, d->m_totalCount - d->m_pageOffset);
+        d->m_insertIndex = d->m_pageOffset;
+    }
     d->m_updateTimer.stop();
 }
 
@@ -387,6 +3290,7 @@ void GriloDataSource::grilo_source_result_cb(GrlSource *source, guint op_id,
                                              gpointer user_data, const GError *error)
 {
     Q_UNUSED(source)
+    GRILO_TRACE_SCOPE("result");
     GriloDataSource *that = static_cast<GriloDataSource *>(user_data);
 
     // We get an error if the operation has been cancelled:
@@ -412,35 +3316,199 @@ void GriloDataSource::grilo_source_result_cb(GrlSource *source, guint op_id,
         return;
     }
 
+    if (that->d->m_fetchingPage != -1) {
+        if (media) {
+            int index = that->d->m_pageOffset + that->d->m_pageResults;
+            that->d->m_stats.result();
+            if (that->d->m_pageResults < that->d->m_pageCount) {
+                ++that->d->m_pageResults;
+                that->setPageRow(index, media);
+            } else {
+                g_object_unref(media);
+            }
+        }
+
+        if (remaining == 0) {
+            that->d->m_opId = 0;
+            that->finishPage(error != 0);
+
+            if (that->d->m_updateScheduled) {
+                that->d->m_updateTimer.start(100, that);
+            }
+
+            if (!that->startNextPage()) {
+                that->setFetching(false);
+                GRILO_TRACE_INSTANT("finished");
+                Q_EMIT that->finished();
+            }
+        }
+        return;
+    }
+
+    GriloSharedResults *shared = that->d->m_shared;
+    if (shared && shared->owner == that) {
+        // Data sources following the operation get the same results.
+        QList<QPointer<GriloDataSource> > followers = shared->followers;
+        if (media) {
+            g_object_ref(media);
+            shared->media.append(media);
+        }
+        if (remaining == 0) {
+            resultCache()->finish(shared, error == 0);
+        }
+        Q_FOREACH (const QPointer<GriloDataSource> &follower, followers) {
+            if (follower && follower->d->m_shared == shared) {
+                if (media) {
+                    g_object_ref(media);
+                }
+                follower->addResult(media, remaining, error != 0);
+            }
+        }
+    }
+
+    if (that->d->m_queueResults) {
+        if (that->d->m_queue.count() >= resultQueueCapacity) {
+            // Falling behind, catch up before taking more.
+            that->drainResults(-1);
+            that->addResult(media, remaining, error != 0);
+            return;
+        }
+
+        GriloQueuedResult result = { media, remaining, error != 0 };
+        that->d->m_queue.enqueue(result);
+        if (!that->d->m_drainTimer.isActive()) {
+            that->d->m_drainTimer.start(0, that);
+            Q_EMIT that->queueDepthChanged();
+        }
+        return;
+    }
+
+    that->addResult(media, remaining, error != 0);
+}
+
+void GriloDataSource::drainResults(int count)
+{
+    d->m_drainTimer.stop();
+
+    int applied = 0;
+    for (; applied != count && !d->m_queue.isEmpty(); ++applied) {
+        GriloQueuedResult result = d->m_queue.dequeue();
+        addResult(result.media, result.remaining, result.failed);
+    }
+
+    if (!d->m_queue.isEmpty()) {
+        d->m_drainTimer.start(0, this);
+    }
+    if (applied > 0) {
+        Q_EMIT queueDepthChanged();
+    }
+}
+
+void GriloDataSource::drainSlice()
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    d->m_drainTimer.stop();
+
+    int applied = 0;
+    Q_FOREVER {
+        // Rows filling the viewport are not held back by the budget.
+        if (!d->inViewport(d->m_insertIndex + d->m_pending.count())) {
+            if (d->m_drainBudget > 0 ? elapsed.elapsed() >= d->m_drainBudget : applied >= d->m_batchSize) {
+                break;
+            }
+        }
+        if (d->m_queue.isEmpty()) {
+            break;
+        }
+        GriloQueuedResult result = d->m_queue.dequeue();
+        addResult(result.media, result.remaining, result.failed);
+        ++applied;
+    }
+
+    if (d->inViewport(d->m_insertIndex)) {
+        // Shown in this frame rather than after the batch interval
+        flushInserts();
+    }
+
+    if (!d->m_queue.isEmpty()) {
+        d->m_drainTimer.start(0, this);
+    }
+    if (applied > 0) {
+        Q_EMIT queueDepthChanged();
+    }
+}
+
+void GriloDataSource::addResult(GrlMedia *media, guint remaining, bool failed)
+{
+    // Results of an operation run by another data source are not ours to cache.
+    bool follower = d->m_shared && d->m_opId == 0;
+
+    if (d->sorted()) {
+        if (d->m_insertIndex == 0 && !d->m_sweeping) {
+            ++d->m_generation;
+            d->m_sweeping = true;
+        }
+    } else if (d->m_insertIndex == 0 && !d->m_refetching && !d->m_media.isEmpty()) {
+        d->beginRefetch();
+    }
+
     if (media) {
-        that->addMedia(media);
+        ++d->m_pageResults;
+        d->m_stats.result();
+        addMedia(media);
     }
 
     if (remaining == 0) {
-        that->d->m_initialFetchDone = true;
-        that->d->m_opId = 0;
+        flushInserts();
+        d->m_initialFetchDone = true;
+        d->m_opId = 0;
 
-        if (that->d->m_updateScheduled) {
-            that->d->m_updateTimer.start(100, that);
+        if (d->m_updateScheduled) {
+            d->m_updateTimer.start(100, this);
         }
 
-        // If there are items from a previous fetch still remaining remove them.
-        if (that->d->m_insertIndex < that->d->m_media.count()) {
-            Q_FOREACH (GriloModel *model, that->d->m_models) {
-                model->beginRemoveRows(QModelIndex(), that->d->m_insertIndex, that->d->m_media.count() - 1);
+        if (d->m_sweeping) {
+            d->m_sweeping = false;
+            // A failed fetch does not tell what is gone.
+            if (!failed) {
+                sweepRows();
             }
-            while (that->d->m_media.count() > that->d->m_insertIndex) {
-                GriloMedia *media = that->d->m_media.takeLast();
-                that->d->m_hash.remove(media->id());
-                delete media;
+        } else if (!d->sorted() && d->m_insertIndex < d->m_media.count()) {
+            // If there are items from a previous fetch still remaining remove them.
+            d->m_stats.count(GriloOperationStats::Removals, d->m_media.count() - d->m_insertIndex, d->m_models.count());
+            Q_FOREACH (GriloModel *model, d->m_models) {
+                model->sourceRowsAboutToBeRemoved(d->m_insertIndex, d->m_media.count() - 1);
+            }
+            while (d->m_media.count() > d->m_insertIndex) {
+                GriloMediaRow row = d->m_media.takeLast();
+                // A row inserted by this fetch may have taken over the id already.
+                QHash<QString, int>::iterator it = d->m_rows.find(row.id);
+                if (it != d->m_rows.end() && it.value() < 0) {
+                    d->m_rows.erase(it);
+                }
+                d->account(row, -1);
+                d->releaseColumns(row);
+                delete row.wrapper;
+                g_object_unref(row.media);
             }
-            Q_FOREACH (GriloModel *model, that->d->m_models) {
-                model->endRemoveRows();
+            d->m_mediaListValid = false;
+            Q_FOREACH (GriloModel *model, d->m_models) {
+                model->sourceRowsRemoved();
             }
         }
-        that->setFetching(false);
-        that->d->m_previouslyAddedId.clear();
-        Q_EMIT that->finished();
+        d->endRefetch();
+        if (!failed && !follower) {
+            saveCache();
+        }
+        // A short page means the source has nothing more to give.
+        d->m_moreAvailable = !failed && d->m_pageSize > 0
+                && d->m_pageResults >= d->m_pageCount
+                && (d->m_count == 0 || d->m_media.count() < d->m_count);
+        setFetching(false);
+        d->m_previouslyAddedId.clear();
+        GRILO_TRACE_INSTANT("finished");
+        Q_EMIT finished();
     }
 }
 
@@ -452,29 +3520,143 @@ void GriloDataSource::contentChanged(const QString &source, GrlSourceChangeType
     Q_UNUSED(changed_media)
 }
 
+void GriloDataSource::sourceContentChanged(const QString &source, GrlSourceChangeType change_type,
+                                           GPtrArray *changed_media, bool location_unknown)
+{
+    d->m_changedSource = source;
+    d->m_locationUnknown = location_unknown;
+
+    if (resultCache.exists()) {
+        resultCache()->invalidate(source);
+    }
+
+    contentChanged(source, change_type, changed_media);
+
+    d->m_changedSource.clear();
+    d->m_locationUnknown = false;
+}
+
 void GriloDataSource::updateContent(GrlSourceChangeType change_type, GPtrArray *changed_media)
 {
+    // Changes are applied directly only when we know exactly which items changed
+    // and no fetch is running which would bring them anyway.
+    bool incremental = d->m_incrementalUpdates && !d->m_locationUnknown
+            && !d->m_changedSource.isEmpty() && d->m_opId == 0;
+
+    if (d->sparse()) {
+        // Rows are tied to their position, any change shifts them.
+        scheduleUpdate();
+        return;
+    }
+
     switch (change_type) {
     case GRL_CONTENT_REMOVED:
-        for (uint i = 0; i < changed_media->len; ++i) {
-            removeMedia((GrlMedia *)g_ptr_array_index(changed_media, i));
+        removeMedia(changed_media);
+        if (!incremental) {
+            // above not enough if content is query grouping items (e.g. album entries).
+            scheduleUpdate();
         }
-        // above not enough if content is query grouping items (e.g. album entries).
-        // fall through
+        break;
     case GRL_CONTENT_CHANGED:
-    case GRL_CONTENT_ADDED:
-        if (!d->m_updateScheduled) {
-            d->m_updateScheduled = true;
-            if (d->m_opId == 0) {
-                d->m_updateTimer.start(100, this);
-            }
+        if (!incremental || !resolveChanges(changed_media)) {
+            scheduleUpdate();
         }
         break;
+    case GRL_CONTENT_ADDED:
+        // Whether the new items belong to the rows is only known by fetching them.
+        scheduleUpdate();
+        break;
     default:
         break;
     }
 }
 
+void GriloDataSource::scheduleUpdate()
+{
+    if (!d->m_updateScheduled) {
+        d->m_updateScheduled = true;
+        if (d->m_opId == 0) {
+            d->m_updateTimer.start(100, this);
+        }
+    }
+}
+
+bool GriloDataSource::resolveChanges(GPtrArray *changed_media)
+{
+    GrlSource *src = d->m_registry ? d->m_registry->lookupSource(d->m_changedSource) : 0;
+    if (!src) {
+        return false;
+    }
+
+    int typeFilter = d->typeFilterFlags();
+
+    GList *keys = keysAsList();
+    GrlOperationOptions *options = operationOptions(src, Resolve);
+
+    for (uint i = 0; i < changed_media->len; ++i) {
+        GrlMedia *media = static_cast<GrlMedia *>(g_ptr_array_index(changed_media, i));
+
+        // Items without a row are not ours.
+        if (d->rowOf(QString::fromUtf8(grl_media_get_id(media))) == -1) {
+            continue;
+        }
+
+        if (typeFilter != GRL_TYPE_FILTER_NONE && !grl_media_is_container(media)) {
+            int mediaFilter = grl_media_is_audio(media) ? GRL_TYPE_FILTER_AUDIO
+                            : grl_media_is_video(media) ? GRL_TYPE_FILTER_VIDEO
+                            : grl_media_is_image(media) ? GRL_TYPE_FILTER_IMAGE
+                            : GRL_TYPE_FILTER_NONE;
+            if (!(typeFilter & mediaFilter)) {
+                continue;
+            }
+        }
+
+        g_object_ref(media);
+        guint opId = grl_source_resolve(src, media, keys, options, grilo_resolve_cb, this);
+        if (opId != 0) {
+            d->m_resolveOps.append(opId);
+        }
+    }
+
+    g_object_unref(options);
+    g_list_free(keys);
+
+    return true;
+}
+
+void GriloDataSource::grilo_resolve_cb(GrlSource *source, guint op_id, GrlMedia *media,
+                                       gpointer user_data, const GError *error)
+{
+    Q_UNUSED(source)
+
+    if (error) {
+        if (error->domain != GRL_CORE_ERROR || error->code != GRL_CORE_ERROR_OPERATION_CANCELLED) {
+            qWarning() << "Resolving changed media failed" << error->message;
+        } else {
+            // Cancelled, the instance might be deleted already
+            g_object_unref(media);
+            return;
+        }
+    }
+
+    GriloDataSource *that = static_cast<GriloDataSource *>(user_data);
+    that->d->m_resolveOps.removeOne(op_id);
+
+    if (error || that->d->m_opId != 0) {
+        // A running fetch brings the item along
+        g_object_unref(media);
+        return;
+    }
+
+    int index = that->d->rowOf(QString::fromUtf8(grl_media_get_id(media)));
+    if (index != -1) {
+        that->updateRow(index, media);
+    } else {
+        // Removed while being resolved
+        g_object_unref(media);
+    }
+}
+
 QVariantList GriloDataSource::listToVariantList(const GList *keys) const
 {
     QVariantList varList;
@@ -488,7 +3670,22 @@ void GriloDataSource::timerEvent(QTimerEvent *event)
 {
     if (event->timerId() == d->m_updateTimer.timerId()) {
         d->m_updateTimer.stop();
+        GRILO_TRACE_INSTANT("contentUpdated");
         Q_EMIT contentUpdated();
+    } else if (event->timerId() == d->m_flushTimer.timerId()) {
+        flushInserts();
+    } else if (event->timerId() == d->m_refreshTimer.timerId()) {
+        d->m_refreshTimer.stop();
+        d->m_refreshing = true;
+        refresh();
+        d->m_refreshing = false;
+    } else if (event->timerId() == d->m_drainTimer.timerId()) {
+        drainSlice();
+    } else if (event->timerId() == d->m_deferredTimer.timerId()) {
+        resolveQueuedKeys();
+    } else if (event->timerId() == d->m_aggregatesTimer.timerId()) {
+        d->m_aggregatesTimer.stop();
+        Q_EMIT aggregatesChanged();
     }
 }
 
@@ -497,9 +3694,19 @@ guint GriloDataSource::getOpId() const
     return d->m_opId;
 }
 
-void GriloDataSource::setOpId(guint id)
+void GriloDataSource::setOpId(guint id, bool shareable)
 {
     d->m_opId = id;
+
+    // Other data sources asking for the same can follow this operation. Not
+    // when keys are deferred, those are resolved into the GrlMedia in place.
+    if (id != 0 && shareable && d->m_sharedResults && d->m_pageSize == 0 && !d->m_shared
+            && d->m_deferredKeys.isEmpty()) {
+        QString key = cacheKey();
+        if (!key.isEmpty()) {
+            d->m_shared = resultCache()->create(key, d->m_operationSource, this);
+        }
+    }
 }
 
 GriloRegistry *GriloDataSource::getGriloRegistry() const
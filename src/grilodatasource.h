@@ -29,6 +29,7 @@
 #include <QObject>
 #include <QVariant>
 #include <QBasicTimer>
+#include <QVector>
 
 #include <grilo.h>
 
@@ -48,10 +49,33 @@ class GRILO_QT_EXPORT GriloDataSource : public QObject
     Q_PROPERTY(QVariantList metadataKeys READ metadataKeys WRITE setMetadataKeys NOTIFY metadataKeysChanged)
     Q_PROPERTY(QVariantList typeFilter READ typeFilter WRITE setTypeFilter NOTIFY typeFilterChanged)
     Q_PROPERTY(bool fetching READ fetching NOTIFY fetchingChanged)
+    Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize NOTIFY batchSizeChanged)
+    Q_PROPERTY(int batchInterval READ batchInterval WRITE setBatchInterval NOTIFY batchIntervalChanged)
+    Q_PROPERTY(bool incrementalUpdates READ incrementalUpdates WRITE setIncrementalUpdates NOTIFY incrementalUpdatesChanged)
+    Q_PROPERTY(int resolution READ resolution WRITE setResolution NOTIFY resolutionChanged)
+    Q_PROPERTY(bool deferSlowKeys READ deferSlowKeys WRITE setDeferSlowKeys NOTIFY deferSlowKeysChanged)
+    Q_PROPERTY(int pageSize READ pageSize WRITE setPageSize NOTIFY pageSizeChanged)
+    Q_PROPERTY(int totalCount READ totalCount WRITE setTotalCount NOTIFY totalCountChanged)
+    Q_PROPERTY(int maxResidentPages READ maxResidentPages WRITE setMaxResidentPages NOTIFY maxResidentPagesChanged)
+    Q_PROPERTY(bool diskCache READ diskCache WRITE setDiskCache NOTIFY diskCacheChanged)
+    Q_PROPERTY(bool sharedResults READ sharedResults WRITE setSharedResults NOTIFY sharedResultsChanged)
+    Q_PROPERTY(int refreshDelay READ refreshDelay WRITE setRefreshDelay NOTIFY refreshDelayChanged)
+    Q_PROPERTY(int refreshMaxWait READ refreshMaxWait WRITE setRefreshMaxWait NOTIFY refreshMaxWaitChanged)
+    Q_PROPERTY(int avoidedOperations READ avoidedOperations NOTIFY avoidedOperationsChanged)
+    Q_PROPERTY(QVariantList sortKeys READ sortKeys WRITE setSortKeys NOTIFY sortKeysChanged)
+    Q_PROPERTY(bool columnar READ columnar WRITE setColumnar NOTIFY columnarChanged)
+    Q_PROPERTY(qint64 totalDuration READ totalDuration NOTIFY aggregatesChanged)
+    Q_PROPERTY(qint64 totalSize READ totalSize NOTIFY aggregatesChanged)
+    Q_PROPERTY(QVariantMap mediaTypeCounts READ mediaTypeCounts NOTIFY aggregatesChanged)
+    Q_PROPERTY(QVariantMap genreCounts READ genreCounts NOTIFY aggregatesChanged)
+    Q_PROPERTY(QVariantMap stats READ stats NOTIFY statsChanged)
+    Q_PROPERTY(bool queueResults READ queueResults WRITE setQueueResults NOTIFY queueResultsChanged)
+    Q_PROPERTY(int drainBudget READ drainBudget WRITE setDrainBudget NOTIFY drainBudgetChanged)
+    Q_PROPERTY(int queueDepth READ queueDepth NOTIFY queueDepthChanged)
 
     Q_ENUMS(MetadataKeys)
     Q_ENUMS(TypeFilter)
-    // TODO: metadata resolution flags ?
+    Q_ENUMS(Resolution)
 
 public:
     enum MetadataKeys {
@@ -107,11 +131,33 @@ public:
         All = GRL_TYPE_FILTER_ALL,
     };
 
+    enum Resolution {
+        Normal = GRL_RESOLVE_NORMAL,
+        Full = GRL_RESOLVE_FULL,
+        IdleRelay = GRL_RESOLVE_IDLE_RELAY,
+        FastOnly = GRL_RESOLVE_FAST_ONLY,
+    };
+
     GriloDataSource(QObject *parent = 0);
     virtual ~GriloDataSource();
 
+    // Creates a GriloMedia for every row, prefer mediaCount() and mediaAt()
     const QList<GriloMedia *> *media() const;
 
+    int mediaCount() const;
+    GriloMedia *mediaAt(int index) const;
+    QVariant mediaValue(int index, quint32 keyId) const;
+
+    // Value as fetched, without resolving deferred keys or fetching the page
+    // of a placeholder row
+    QVariant cachedValue(int index, quint32 keyId) const;
+
+    // Compiles the filters of the model once for matchingRows(), see
+    // GriloModel::filters. Empty filters forget the model.
+    void setFilters(GriloModel *model, const QVariantList &filters);
+    // Rows from first to last matching all the filters set for the model
+    QVector<int> matchingRows(GriloModel *model, int first, int last) const;
+
     void addModel(GriloModel *model);
     void removeModel(GriloModel *model);
     void prefill(GriloModel *model);
@@ -135,6 +181,138 @@ public:
 
     bool fetching() const;
 
+    // Results are inserted into the models in ranges of up to batchSize rows,
+    // or whatever arrived within batchInterval milliseconds. An interval of 0
+    // only flushes on size and at the end of the operation.
+    int batchSize() const;
+    void setBatchSize(int size);
+
+    int batchInterval() const;
+    void setBatchInterval(int interval);
+
+    // When enabled changed items reported by the source are resolved and
+    // applied to their rows directly instead of emitting contentUpdated for
+    // a full refresh. Changed items without a row are ignored. Added items
+    // and changes with an unknown location still request a full refresh, as
+    // only fetching tells whether the items belong to the result set.
+    bool incrementalUpdates() const;
+    void setIncrementalUpdates(bool incremental);
+
+    // Resolution flags of the operations, a combination of Resolution values
+    int resolution() const;
+    void setResolution(int resolution);
+
+    // When enabled the slow keys of the source are left out of the operation
+    // and resolved in the background for the rows that are accessed.
+    bool deferSlowKeys() const;
+    void setDeferSlowKeys(bool defer);
+
+    // When set refresh() only fetches the first pageSize items, further pages
+    // are appended by fetchMore(). Refreshing fetches again all pages loaded so far.
+    int pageSize() const;
+    void setPageSize(int size);
+
+    Q_INVOKABLE bool canFetchMore() const;
+    Q_INVOKABLE bool fetchMore();
+
+    // When the number of items is known up front and a pageSize is set the
+    // models get totalCount rows right away. Rows are empty until accessed,
+    // which fetches the page they are on. Content changes request a refresh.
+    int totalCount() const;
+    void setTotalCount(int count);
+
+    // Pages kept in memory in sparse mode, those furthest from the last
+    // accessed row are dropped first. Should cover a few screens, 0 keeps all.
+    int maxResidentPages() const;
+    void setMaxResidentPages(int pages);
+
+    // When enabled the results of a completed fetch are stored on disk and
+    // shown right away by the next refresh of an empty model while the
+    // operation runs. Only data sources with an operationKey() are cached.
+    // The least recently written files are removed once there are more than
+    // 64 of them or they take more than 32 MiB. Files are written by a
+    // background thread.
+    bool diskCache() const;
+    void setDiskCache(bool enabled);
+
+    // When enabled data sources with the same operation share one running
+    // operation and the GrlMedia of its results, which stay cached in the
+    // process until content of the source changes. Not used with paging or
+    // for operations leaving out slow keys, see deferSlowKeys.
+    bool sharedResults() const;
+    void setSharedResults(bool shared);
+
+    // Rows kept in the shared results cache by entries nobody shows
+    static int sharedResultsLimit();
+    static void setSharedResultsLimit(int rows);
+
+    // When set refresh() waits until it has not been called for refreshDelay
+    // milliseconds, but no longer than refreshMaxWait (0 for no limit), and
+    // only then replaces the running operation. A refresh asking for the same
+    // as the running or pending one is dropped. Without a delay every
+    // refresh() restarts the operation.
+    int refreshDelay() const;
+    void setRefreshDelay(int delay);
+
+    int refreshMaxWait() const;
+    void setRefreshMaxWait(int wait);
+
+    // Operations not started because a refresh was coalesced with a later
+    // one or asked for the same as the running or pending one.
+    int avoidedOperations() const;
+
+    // MetadataKeys to keep the rows ordered by, a negated key sorts descending.
+    // Text is compared by collation keys computed once per row. New rows are
+    // batched like unsorted ones and each batch is merged into the rows as
+    // ranges of adjacent rows. A refetch updates and moves rows in place and
+    // removes those it did not return. Not used in sparse mode.
+    QVariantList sortKeys() const;
+    void setSortKeys(const QVariantList &keys);
+
+    // Also keep the metadataKeys of every row in a column store: numbers in
+    // packed arrays and text in a pool of unique strings. Filters and numeric
+    // sort keys are then read from the columns.
+    bool columnar() const;
+    void setColumnar(bool columnar);
+
+    // Results arriving from Grilo are queued and applied from the event loop
+    // for up to drainBudget ms per iteration, or batchSize of them with a
+    // budget of 0, so that a burst delivered at once does not block the event
+    // loop until all of it is in the models. Results landing within the
+    // viewport are applied regardless of the budget. Grilo and its plugins
+    // still run on the GUI thread: the core relays results through idle
+    // sources on the global default main context, so a worker thread with a
+    // GMainContext of its own would not take that work off the GUI thread.
+    bool queueResults() const;
+    void setQueueResults(bool queue);
+
+    int drainBudget() const;
+    void setDrainBudget(int budget);
+
+    // Results waiting to be applied, updated once per event loop iteration
+    int queueDepth() const;
+
+    // Rows currently shown by the view, as from ListView.indexAt(). Not used
+    // when sorting, where the row of a result is only known once applied.
+    Q_INVOKABLE void setViewport(int first, int last);
+
+    // Totals over the fetched rows, kept up to date as rows are inserted,
+    // updated and removed. In sparse mode only the resident pages count.
+    // Durations are in seconds and sizes in bytes. The media type counts
+    // are keyed by "audio", "video", "image", "container" and "unknown".
+    qint64 totalDuration() const;
+    qint64 totalSize() const;
+    QVariantMap mediaTypeCounts() const;
+    QVariantMap genreCounts() const;
+
+    // Timings and counters of the last finished operation: "duration",
+    // "firstResult" and "lastResult" in milliseconds since it started,
+    // "results", the rows changed as "inserts", "moves", "updates",
+    // "removals" and "resets", and "modelSignals" sent to the models.
+    // Also logged as debug messages to the grilo.qt.operation category, which
+    // is disabled unless enabled by QT_LOGGING_RULES.
+    QVariantMap stats() const;
+
 public Q_SLOTS:
     void cancelRefresh();
     virtual void availableSourcesChanged() = 0;
@@ -148,19 +326,45 @@ Q_SIGNALS:
     void finished();
     void contentUpdated();
     void fetchingChanged();
+    void batchSizeChanged();
+    void batchIntervalChanged();
+    void incrementalUpdatesChanged();
+    void resolutionChanged();
+    void deferSlowKeysChanged();
+    void pageSizeChanged();
+    void totalCountChanged();
+    void maxResidentPagesChanged();
+    void diskCacheChanged();
+    void sharedResultsChanged();
+    void refreshDelayChanged();
+    void refreshMaxWaitChanged();
+    void avoidedOperationsChanged();
+    void sortKeysChanged();
+    void columnarChanged();
+    void aggregatesChanged();
+    void statsChanged();
+    void queueResultsChanged();
+    void drainBudgetChanged();
+    void queueDepthChanged();
 
 protected:
     enum OperationType {
         Browse = GRL_OP_BROWSE,
         Search = GRL_OP_SEARCH,
+        Resolve = GRL_OP_RESOLVE,
     };
 
     static void grilo_source_result_cb(GrlSource *source, guint browse_id,
                                        GrlMedia *media, guint remaining,
                                        gpointer user_data, const GError *error);
+    static void grilo_resolve_cb(GrlSource *source, guint op_id, GrlMedia *media,
+                                 gpointer user_data, const GError *error);
+    static void grilo_deferred_keys_cb(GrlSource *source, guint op_id, GrlMedia *media,
+                                       gpointer user_data, const GError *error);
 
     void addMedia(GrlMedia *media);
     void removeMedia(GrlMedia *media);
+    void removeMedia(GPtrArray *media);
 
     void clearMedia();
 
@@ -168,22 +372,86 @@ protected:
 
     void setFetching(bool active);
 
+    // Issues the operation of the data source, with the options from operationOptions()
+    virtual bool startOperation();
+    // Cancels the running operation, getOpId() is still set
+    virtual void cancelOperation();
+    // Like cancelRefresh() but a refresh waiting for refreshDelay stays pending
+    void stopOperation();
+
+    // For data sources running their own operations instead of reporting the
+    // results through grilo_source_result_cb(). The row is inserted at index
+    // right away, finishOperation() ends the fetch once everything arrived.
+    void insertMedia(int index, GrlMedia *media);
+    // Inserts media among the rows merged before by the value of keyId, none
+    // for 0, and then by order. Rows without the key go last.
+    void mergeMedia(GrlMedia *media, quint32 keyId, qint64 order);
+    void finishOperation(bool failed);
+
+    // Identifies the operation for caching its results, source and what is
+    // asked from it. Keys and options are added by the data source.
+    virtual QString operationKey() const;
+    // Called first by refresh(), returns true when the refresh was postponed or dropped
+    bool deferRefresh();
+    bool followSharedResults();
+
+    // Removes the rows without text in their title, artist or album and lets
+    // the next operation match the remaining ones by id. Returns the number
+    // of rows left or -1 if the rows could not be filtered.
+    int retainMatchingRows(const QString &text);
+    bool loadCache();
+
     GrlOperationOptions *operationOptions(GrlSource *src, const OperationType &type);
-    GList *keysAsList();
+    GList *keysAsList(GrlSource *src = 0);
 
     QVariantList listToVariantList(const GList *keys) const;
 
     void timerEvent(QTimerEvent *event);
 
     guint getOpId() const;
-    void setOpId(guint id);
+    // Only shareable operations report all results through grilo_source_result_cb()
+    void setOpId(guint id, bool shareable = true);
     GriloRegistry *getGriloRegistry() const;
 
 protected Q_SLOTS:
     virtual void contentChanged(const QString &source, GrlSourceChangeType change_type,
                                 GPtrArray *changed_media);
 
+private Q_SLOTS:
+    void sourceContentChanged(const QString &source, GrlSourceChangeType change_type,
+                              GPtrArray *changed_media, bool location_unknown);
+
 private:
+    void scheduleUpdate();
+    bool resolveChanges(GPtrArray *changed_media);
+    void updateRow(int index, GrlMedia *media);
+    // Resolves the slow keys of the rows accessed since, a few at a time
+    void resolveQueuedKeys();
+    void resolveDeferredKeys(int index);
+    // Flushes the new rows or schedules it after one was added to the pending ones
+    void pendingAdded();
+    void flushInserts();
+    void flushSortedInserts();
+    void removeRow(int index, int unmatchedPosition);
+    void removeRows(int first, int last);
+    void addSortedMedia(GrlMedia *media);
+    int resortRow(int index);
+    void sweepRows();
+    void resetPages();
+    void requestPage(int page);
+    bool startNextPage();
+    void setPageRow(int index, GrlMedia *media);
+    void finishPage(bool failed);
+    void evictPages();
+    void clearRows(int first, int last);
+    void addResult(GrlMedia *media, guint remaining, bool failed);
+    // Applies up to count queued results, all of them for -1
+    void drainResults(int count);
+    void drainSlice();
+    QString cacheKey() const;
+    QString cacheFilePath() const;
+    void saveCache();
+
     GriloDataSourcePrivate *d;
 };
 
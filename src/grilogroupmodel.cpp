@@ -0,0 +1,445 @@
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "grilogroupmodel.h"
+#include "grilodatasource.h"
+#include "grilomodel.h"
+
+#include <QCollator>
+#include <QDateTime>
+#include <QVector>
+
+#include <algorithm>
+
+struct GriloGroup
+{
+    QString name;
+    // Start of the bucket when grouping by date
+    QDateTime date;
+    int count;
+    // Created when asked for
+    GriloModel *model;
+};
+
+class GriloGroupModelPrivate
+{
+public:
+    GriloGroupModelPrivate();
+
+    QString groupOf(int row) const;
+    QDateTime dateOf(const QString &name) const;
+    int compare(const QString &left, const QString &right) const;
+    // Position of the group, or where it would be inserted
+    int find(const QString &name, bool *found) const;
+    QVariantList filtersOf(const GriloGroup &group) const;
+
+    GriloDataSource *m_source;
+    // Follows the rows of the source
+    GriloModel *m_rows;
+
+    int m_groupKey;
+    bool m_dates;
+    GriloGroupModel::DateBucket m_dateBucket;
+
+    // Ordered by name
+    QVector<GriloGroup> m_groups;
+    // Group of every row of the source
+    QVector<QString> m_rowGroups;
+
+    QCollator m_collator;
+};
+
+GriloGroupModelPrivate::GriloGroupModelPrivate()
+    : m_source(nullptr)
+    , m_rows(nullptr)
+    , m_groupKey(0)
+    , m_dates(false)
+    , m_dateBucket(GriloGroupModel::Day)
+{
+    m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+    m_collator.setNumericMode(true);
+}
+
+QString GriloGroupModelPrivate::groupOf(int row) const
+{
+    QVariant value = m_source->cachedValue(row, m_groupKey);
+
+    if (m_dates) {
+        QDateTime date = value.toDateTime().toLocalTime();
+        if (!date.isValid()) {
+            return QString();
+        }
+        return date.toString(m_dateBucket == GriloGroupModel::Day ? "yyyy-MM-dd" : "yyyy-MM");
+    }
+
+    return value.toString();
+}
+
+QDateTime GriloGroupModelPrivate::dateOf(const QString &name) const
+{
+    QDate date = QDate::fromString(name, m_dateBucket == GriloGroupModel::Day ? "yyyy-MM-dd" : "yyyy-MM");
+    return date.isValid() ? QDateTime(date, QTime(0, 0)) : QDateTime();
+}
+
+int GriloGroupModelPrivate::compare(const QString &left, const QString &right) const
+{
+    // Date buckets are named so that they sort as plain strings.
+    return m_dates ? left.compare(right) : m_collator.compare(left, right);
+}
+
+int GriloGroupModelPrivate::find(const QString &name, bool *found) const
+{
+    int first = 0;
+    int last = m_groups.count();
+
+    while (first < last) {
+        int middle = (first + last) / 2;
+        int order = compare(m_groups.at(middle).name, name);
+        if (order == 0 && m_groups.at(middle).name == name) {
+            *found = true;
+            return middle;
+        }
+        if (order < 0 || (order == 0 && m_groups.at(middle).name < name)) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    *found = false;
+    return first;
+}
+
+QVariantList GriloGroupModelPrivate::filtersOf(const GriloGroup &group) const
+{
+    QVariantMap filter;
+    filter.insert("key", m_groupKey);
+
+    if (m_dates) {
+        QDateTime end = m_dateBucket == GriloGroupModel::Day ? group.date.addDays(1) : group.date.addMonths(1);
+        filter.insert("min", group.date);
+        filter.insert("max", end.addMSecs(-1));
+    } else {
+        filter.insert("value", group.name);
+    }
+
+    return QVariantList() << filter;
+}
+
+GriloGroupModel::GriloGroupModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , d(new GriloGroupModelPrivate)
+{
+    d->m_rows = new GriloModel(this);
+
+    QObject::connect(d->m_rows, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+                     this, SLOT(sourceRowsInserted(const QModelIndex &, int, int)));
+    QObject::connect(d->m_rows, SIGNAL(rowsRemoved(const QModelIndex &, int, int)),
+                     this, SLOT(sourceRowsRemoved(const QModelIndex &, int, int)));
+    QObject::connect(d->m_rows, SIGNAL(rowsMoved(const QModelIndex &, int, int, const QModelIndex &, int)),
+                     this, SLOT(sourceRowsMoved(const QModelIndex &, int, int, const QModelIndex &, int)));
+    QObject::connect(d->m_rows, SIGNAL(dataChanged(const QModelIndex &, const QModelIndex &)),
+                     this, SLOT(sourceRowsChanged(const QModelIndex &, const QModelIndex &)));
+    QObject::connect(d->m_rows, SIGNAL(modelReset()),
+                     this, SLOT(rebuild()));
+
+    QObject::connect(this, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+                     this, SIGNAL(countChanged()));
+    QObject::connect(this, SIGNAL(rowsRemoved(const QModelIndex &, int, int)),
+                     this, SIGNAL(countChanged()));
+    QObject::connect(this, SIGNAL(modelReset()),
+                     this, SIGNAL(countChanged()));
+}
+
+GriloGroupModel::~GriloGroupModel()
+{
+    d->m_rows->setSource(0);
+    delete d;
+}
+
+QHash<int, QByteArray> GriloGroupModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[NameRole] = "name";
+    roles[CountRole] = "count";
+    roles[DateRole] = "date";
+    roles[ModelRole] = "model";
+    return roles;
+}
+
+int GriloGroupModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return d->m_groups.count();
+    }
+
+    return 0;
+}
+
+QVariant GriloGroupModel::data(const QModelIndex &index, int role) const
+{
+    if (index.row() < 0 || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    const GriloGroup &group = d->m_groups.at(index.row());
+
+    switch (role) {
+    case NameRole:
+        return group.name;
+    case CountRole:
+        return group.count;
+    case DateRole:
+        return group.date.isValid() ? QVariant(group.date) : QVariant();
+    case ModelRole:
+        return QVariant::fromValue<QObject *>(const_cast<GriloGroupModel *>(this)->groupModel(index.row()));
+    }
+
+    return QVariant();
+}
+
+GriloDataSource *GriloGroupModel::source() const
+{
+    return d->m_source;
+}
+
+void GriloGroupModel::setSource(GriloDataSource *source)
+{
+    if (d->m_source == source) {
+        return;
+    }
+
+    d->m_source = source;
+    // Resets the groups and adds the rows already in the source.
+    d->m_rows->setSource(source);
+
+    Q_EMIT sourceChanged();
+}
+
+int GriloGroupModel::groupKey() const
+{
+    return d->m_groupKey;
+}
+
+void GriloGroupModel::setGroupKey(int key)
+{
+    if (d->m_groupKey == key) {
+        return;
+    }
+
+    d->m_groupKey = key;
+    d->m_dates = key > 0 && grl_metadata_key_get_type(key) == G_TYPE_DATE_TIME;
+    rebuild();
+
+    Q_EMIT groupKeyChanged();
+}
+
+GriloGroupModel::DateBucket GriloGroupModel::dateBucket() const
+{
+    return d->m_dateBucket;
+}
+
+void GriloGroupModel::setDateBucket(DateBucket bucket)
+{
+    if (d->m_dateBucket == bucket) {
+        return;
+    }
+
+    d->m_dateBucket = bucket;
+    if (d->m_dates) {
+        rebuild();
+    }
+
+    Q_EMIT dateBucketChanged();
+}
+
+int GriloGroupModel::count() const
+{
+    return rowCount();
+}
+
+GriloModel *GriloGroupModel::groupModel(int index)
+{
+    if (index < 0 || index >= rowCount()) {
+        return nullptr;
+    }
+
+    GriloGroup &group = d->m_groups[index];
+    if (!group.model) {
+        group.model = new GriloModel(this);
+        group.model->setFilters(d->filtersOf(group));
+        group.model->setSource(d->m_source);
+    }
+
+    return group.model;
+}
+
+void GriloGroupModel::sourceRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+
+    if (d->m_groupKey <= 0) {
+        return;
+    }
+
+    QHash<QString, int> deltas;
+    d->m_rowGroups.insert(first, last - first + 1, QString());
+    for (int i = first; i <= last; ++i) {
+        QString name = d->groupOf(i);
+        d->m_rowGroups[i] = name;
+        ++deltas[name];
+    }
+
+    changeCounts(deltas);
+}
+
+void GriloGroupModel::sourceRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+
+    if (d->m_groupKey <= 0) {
+        return;
+    }
+
+    QHash<QString, int> deltas;
+    for (int i = first; i <= last; ++i) {
+        --deltas[d->m_rowGroups.at(i)];
+    }
+    d->m_rowGroups.remove(first, last - first + 1);
+
+    changeCounts(deltas);
+}
+
+void GriloGroupModel::sourceRowsMoved(const QModelIndex &parent, int first, int last,
+                                      const QModelIndex &destination, int row)
+{
+    Q_UNUSED(parent);
+    Q_UNUSED(destination);
+
+    if (d->m_groupKey <= 0) {
+        return;
+    }
+
+    QVector<QString>::iterator begin = d->m_rowGroups.begin();
+    if (row > last) {
+        std::rotate(begin + first, begin + last + 1, begin + row);
+    } else {
+        std::rotate(begin + row, begin + first, begin + last + 1);
+    }
+}
+
+void GriloGroupModel::sourceRowsChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (d->m_groupKey <= 0) {
+        return;
+    }
+
+    QHash<QString, int> deltas;
+    for (int i = topLeft.row(); i <= bottomRight.row(); ++i) {
+        QString name = d->groupOf(i);
+        if (name != d->m_rowGroups.at(i)) {
+            --deltas[d->m_rowGroups.at(i)];
+            ++deltas[name];
+            d->m_rowGroups[i] = name;
+        }
+    }
+
+    changeCounts(deltas);
+}
+
+void GriloGroupModel::rebuild()
+{
+    beginResetModel();
+
+    Q_FOREACH (const GriloGroup &group, d->m_groups) {
+        if (group.model) {
+            group.model->deleteLater();
+        }
+    }
+    d->m_groups.clear();
+    d->m_rowGroups.clear();
+
+    int rows = d->m_rows->rowCount();
+    if (d->m_groupKey > 0 && rows > 0) {
+        QHash<QString, int> counts;
+        d->m_rowGroups.resize(rows);
+        for (int i = 0; i < rows; ++i) {
+            QString name = d->groupOf(i);
+            d->m_rowGroups[i] = name;
+            ++counts[name];
+        }
+
+        for (QHash<QString, int>::const_iterator it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            GriloGroup group;
+            group.name = it.key();
+            group.date = d->m_dates ? d->dateOf(group.name) : QDateTime();
+            group.count = it.value();
+            group.model = nullptr;
+            d->m_groups.append(group);
+        }
+
+        std::sort(d->m_groups.begin(), d->m_groups.end(), [this](const GriloGroup &left, const GriloGroup &right) {
+            int order = d->compare(left.name, right.name);
+            return order < 0 || (order == 0 && left.name < right.name);
+        });
+    }
+
+    endResetModel();
+}
+
+void GriloGroupModel::changeCounts(const QHash<QString, int> &deltas)
+{
+    for (QHash<QString, int>::const_iterator it = deltas.constBegin(); it != deltas.constEnd(); ++it) {
+        if (it.value() == 0) {
+            continue;
+        }
+
+        bool found;
+        int index = d->find(it.key(), &found);
+
+        if (!found) {
+            GriloGroup group;
+            group.name = it.key();
+            group.date = d->m_dates ? d->dateOf(group.name) : QDateTime();
+            group.count = it.value();
+            group.model = nullptr;
+
+            beginInsertRows(QModelIndex(), index, index);
+            d->m_groups.insert(index, group);
+            endInsertRows();
+            continue;
+        }
+
+        GriloGroup &group = d->m_groups[index];
+        group.count += it.value();
+
+        if (group.count > 0) {
+            QModelIndex modelIndex = this->index(index, 0);
+            Q_EMIT dataChanged(modelIndex, modelIndex, QVector<int>() << CountRole);
+        } else {
+            GriloModel *model = group.model;
+            beginRemoveRows(QModelIndex(), index, index);
+            d->m_groups.remove(index);
+            endRemoveRows();
+            if (model) {
+                model->deleteLater();
+            }
+        }
+    }
+}
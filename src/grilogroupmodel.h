@@ -0,0 +1,104 @@
+// -*- c++ -*-
+
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GRILO_GROUP_MODEL_H
+#define GRILO_GROUP_MODEL_H
+
+#include <GriloQt>
+
+#include <QAbstractListModel>
+
+class GriloDataSource;
+class GriloModel;
+class GriloGroupModelPrivate;
+
+// Lists the groups of the rows of a data source sharing the value of
+// groupKey, dates are bucketed by day or month. Membership and counts are
+// updated as rows are inserted, changed and removed.
+class GRILO_QT_EXPORT GriloGroupModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(GriloDataSource *source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(int groupKey READ groupKey WRITE setGroupKey NOTIFY groupKeyChanged)
+    Q_PROPERTY(DateBucket dateBucket READ dateBucket WRITE setDateBucket NOTIFY dateBucketChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+    Q_ENUMS(DateBucket)
+
+public:
+    enum {
+        NameRole = Qt::UserRole + 1,
+        CountRole,
+        DateRole,
+        ModelRole,
+    };
+
+    enum DateBucket {
+        Day,
+        Month,
+    };
+
+    GriloGroupModel(QObject *parent = 0);
+    virtual ~GriloGroupModel();
+
+    QHash<int, QByteArray> roleNames() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    GriloDataSource *source() const;
+    void setSource(GriloDataSource *source);
+
+    // MetadataKey to group by, GriloDataSource::Album for instance
+    int groupKey() const;
+    void setGroupKey(int key);
+
+    DateBucket dateBucket() const;
+    void setDateBucket(DateBucket bucket);
+
+    int count() const;
+
+    // Rows of the group, filtered from the same data source. Owned by the
+    // group model and deleted with the group. The unnamed group of the rows
+    // without a value has no rows here.
+    Q_INVOKABLE GriloModel *groupModel(int index);
+
+Q_SIGNALS:
+    void sourceChanged();
+    void groupKeyChanged();
+    void dateBucketChanged();
+    void countChanged();
+
+private Q_SLOTS:
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first, int last);
+    void sourceRowsMoved(const QModelIndex &parent, int first, int last,
+                         const QModelIndex &destination, int row);
+    void sourceRowsChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void rebuild();
+
+private:
+    void changeCounts(const QHash<QString, int> &deltas);
+
+    GriloGroupModelPrivate *d;
+};
+
+#endif /* GRILO_GROUP_MODEL_H */
@@ -22,13 +22,51 @@
 #include "grilomedia.h"
 
 #include <QDebug>
+#include <QHash>
+#include <QReadWriteLock>
+
+// Key names are resolved from QML on every binding evaluation, so keep our
+// own name to id table instead of asking the registry each time.
+class GriloKeyNames
+{
+public:
+    GriloKeyNames()
+        : m_lastKey(GRL_METADATA_KEY_INVALID)
+    {
+    }
+
+    QReadWriteLock m_lock;
+    QHash<QString, GrlKeyID> m_keys;
+    GrlKeyID m_lastKey;
+};
+
+Q_GLOBAL_STATIC(GriloKeyNames, keyNames)
 
 class GriloMediaPrivate
 {
 public:
+    QVariant cachedUrl(GrlKeyID key, bool encoded);
+
     GrlMedia *m_media;
+
+    // Converted values by key id, filled on first access. Values derived
+    // from a key, like urls, are stored under the negated key id.
+    QHash<int, QVariant> m_values;
 };
 
+QVariant GriloMediaPrivate::cachedUrl(GrlKeyID key, bool encoded)
+{
+    QHash<int, QVariant>::const_iterator it = m_values.constFind(-int(key));
+    if (it != m_values.constEnd()) {
+        return it.value();
+    }
+
+    const gchar *string = grl_data_get_string(GRL_DATA(m_media), key);
+    QUrl url = encoded ? QUrl::fromEncoded(QByteArray(string)) : QUrl(string);
+
+    return m_values.insert(-int(key), url).value();
+}
+
 GriloMedia::GriloMedia(GrlMedia *media, QObject *parent)
     : QObject(parent)
     , d(new GriloMediaPrivate)
@@ -54,18 +92,17 @@ void GriloMedia::setMedia(GrlMedia *media)
         g_object_unref(d->m_media);
         d->m_media = media;
     }
+
+    // Also when the same media was resolved further in place
+    d->m_values.clear();
 }
 
-QVariant GriloMedia::get(const QString &keyId) const
+QVariant GriloMedia::get(const QString &keyName) const
 {
-    // There is a GriloRegistry Qt object, but it is not smart to add a
-    // dependency to it here since GrlRegistry is, actually, a
-    // singleton.
-    GrlKeyID actualKey = grl_registry_lookup_metadata_key(grl_registry_get_default(),
-                                                          keyId.toUtf8().constData());
+    GrlKeyID actualKey = keyId(keyName);
 
     if (GRL_METADATA_KEY_INVALID == actualKey) {
-        qWarning() << "Grilo key doesn't exist in the registry:" << keyId;
+        qWarning() << "Grilo key doesn't exist in the registry:" << keyName;
         return QVariant();
     }
 
@@ -74,7 +111,54 @@ QVariant GriloMedia::get(const QString &keyId) const
 
 QVariant GriloMedia::get(const quint32 keyId) const
 {
-    const GValue *gValue = grl_data_get(GRL_DATA(d->m_media), keyId);
+    QHash<int, QVariant>::const_iterator it = d->m_values.constFind(int(keyId));
+    if (it != d->m_values.constEnd()) {
+        return it.value();
+    }
+
+    return d->m_values.insert(int(keyId), value(d->m_media, keyId)).value();
+}
+
+quint32 GriloMedia::keyId(const QString &name)
+{
+    GriloKeyNames *names = keyNames();
+
+    {
+        QReadLocker locker(&names->m_lock);
+        QHash<QString, GrlKeyID>::const_iterator it = names->m_keys.constFind(name);
+        if (it != names->m_keys.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QWriteLocker locker(&names->m_lock);
+
+    // Pick up the keys registered since the last lookup, plugins keep adding them.
+    while (const char *keyName = GRL_METADATA_KEY_GET_NAME(names->m_lastKey + 1)) {
+        ++names->m_lastKey;
+        names->m_keys.insert(QString::fromUtf8(keyName), names->m_lastKey);
+    }
+
+    QHash<QString, GrlKeyID>::const_iterator it = names->m_keys.constFind(name);
+    if (it != names->m_keys.constEnd()) {
+        return it.value();
+    }
+
+    // There is a GriloRegistry Qt object, but it is not smart to add a
+    // dependency to it here since GrlRegistry is, actually, a
+    // singleton.
+    GrlKeyID key = grl_registry_lookup_metadata_key(grl_registry_get_default(),
+                                                    name.toUtf8().constData());
+    if (key != GRL_METADATA_KEY_INVALID) {
+        names->m_keys.insert(name, key);
+    }
+
+    return key;
+}
+
+QVariant GriloMedia::value(GrlMedia *media, quint32 keyId)
+{
+    const GValue *gValue = grl_data_get(GRL_DATA(media), keyId);
 
     return convertValue(gValue);
 }
@@ -94,19 +178,17 @@ QString GriloMedia::serialize()
 
 QString GriloMedia::id() const
 {
-    return QString::fromUtf8(grl_media_get_id(d->m_media));
+    return get(GRL_METADATA_KEY_ID).toString();
 }
 
 QString GriloMedia::title() const
 {
-    return QString::fromUtf8(grl_media_get_title(d->m_media));
+    return get(GRL_METADATA_KEY_TITLE).toString();
 }
 
 QUrl GriloMedia::url() const
 {
-    QUrl url = QUrl::fromEncoded(QByteArray(grl_media_get_url(d->m_media)));
-
-    return url;
+    return d->cachedUrl(GRL_METADATA_KEY_URL, true).toUrl();
 }
 
 int GriloMedia::mediaType() const
@@ -121,32 +203,32 @@ int GriloMedia::duration() const
 
 QString GriloMedia::author() const
 {
-    return QString::fromUtf8(grl_media_get_author(d->m_media));
+    return get(GRL_METADATA_KEY_AUTHOR).toString();
 }
 
 QString GriloMedia::album() const
 {
-    return QString::fromUtf8(grl_media_get_album(d->m_media));
+    return get(GRL_METADATA_KEY_ALBUM).toString();
 }
 
 QString GriloMedia::artist() const
 {
-    return QString::fromUtf8(grl_media_get_artist(d->m_media));
+    return get(GRL_METADATA_KEY_ARTIST).toString();
 }
 
 QString GriloMedia::albumArtist() const
 {
-    return QString::fromUtf8(grl_media_get_album_artist(d->m_media));
+    return get(GRL_METADATA_KEY_ALBUM_ARTIST).toString();
 }
 
 QString GriloMedia::genre() const
 {
-    return QString::fromUtf8(grl_media_get_genre(d->m_media));
+    return get(GRL_METADATA_KEY_GENRE).toString();
 }
 
 QUrl GriloMedia::thumbnail() const
 {
-    return QUrl(grl_media_get_thumbnail(d->m_media));
+    return d->cachedUrl(GRL_METADATA_KEY_THUMBNAIL, false).toUrl();
 }
 
 int GriloMedia::year() const
@@ -166,18 +248,12 @@ int GriloMedia::childCount() const
 
 QString GriloMedia::mimeType() const
 {
-    return QString::fromUtf8(grl_media_get_mime(d->m_media));
+    return get(GRL_METADATA_KEY_MIME).toString();
 }
 
 QDateTime GriloMedia::modificationDate() const
 {
-    GDateTime *dateTime = grl_media_get_modification_date(d->m_media);
-
-    if (dateTime) {
-        return QDateTime::fromTime_t(g_date_time_to_unix(dateTime));
-    }
-
-    return QDateTime();
+    return get(GRL_METADATA_KEY_MODIFICATION_DATE).toDateTime();
 }
 
 int GriloMedia::height() const
@@ -195,7 +271,7 @@ int GriloMedia::width() const
     return grl_media_get_width(d->m_media);
 }
 
-QVariant GriloMedia::convertValue(const GValue *value) const
+QVariant GriloMedia::convertValue(const GValue *value)
 {
     if (!value) {
         return QVariant();
@@ -97,8 +97,12 @@ public:
     Q_INVOKABLE QVariant get(const quint32 keyId) const;
     Q_INVOKABLE QString serialize();
 
+    static QVariant value(GrlMedia *media, quint32 keyId);
+    // Cached lookup of a metadata key id by its name
+    static quint32 keyId(const QString &name);
+
 private:
-    QVariant convertValue(const GValue *value) const;
+    static QVariant convertValue(const GValue *value);
 
     GriloMediaPrivate *d;
 };
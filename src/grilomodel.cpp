@@ -27,23 +27,108 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
 class GriloModelPrivate
 {
 public:
+    GriloModelPrivate(GriloModel *q);
+
+    void updateRoleNames();
+
+    bool filtered() const { return !m_filters.isEmpty(); }
+    int sourceRow(int row) const { return filtered() ? m_rows.at(row) : row; }
+    int lowerBound(int sourceRow) const;
+    void rebuild();
+
+    GriloModel *q;
     GriloDataSource *m_source;
 
-    mutable QHash<int, QByteArray> m_roleNames;
+    QVariantList m_filters;
+    // Source rows matching the filters, in source order
+    QVector<int> m_rows;
+    // Source rows the model knows about
+    int m_sourceCount;
+
+    // Source change being notified and the rows of the model it affects
+    int m_first;
+    int m_last;
+    int m_proxyFirst;
+    int m_proxyLast;
+    bool m_moving;
+
+    QHash<int, QByteArray> m_roleNames;
+    // Roles are MediaRole + key id, so the keys known so far are the roles
+    // MediaRole + 1 ... MediaRole + m_keyCount
+    int m_keyCount;
 };
 
+GriloModelPrivate::GriloModelPrivate(GriloModel *q)
+    : q(q)
+    , m_source(nullptr)
+    , m_sourceCount(0)
+    , m_first(0)
+    , m_last(-1)
+    , m_proxyFirst(-1)
+    , m_proxyLast(-1)
+    , m_moving(false)
+    , m_keyCount(0)
+{
+}
+
+int GriloModelPrivate::lowerBound(int sourceRow) const
+{
+    return std::lower_bound(m_rows.constBegin(), m_rows.constEnd(), sourceRow) - m_rows.constBegin();
+}
+
+void GriloModelPrivate::rebuild()
+{
+    m_sourceCount = m_source ? m_source->mediaCount() : 0;
+    m_rows.clear();
+
+    if (filtered() && m_sourceCount > 0) {
+        m_rows = m_source->matchingRows(q, 0, m_sourceCount - 1);
+    }
+}
+
+void GriloModelPrivate::updateRoleNames()
+{
+    if (m_roleNames.isEmpty()) {
+        grl_init(0, 0);
+        m_roleNames[GriloModel::MediaRole] = "media";
+    }
+
+    // Keys are only ever added to the registry so checking for a name
+    // after the last known key is enough to notice new ones.
+    while (const char *metadataKey = GRL_METADATA_KEY_GET_NAME(m_keyCount + 1)) {
+        ++m_keyCount;
+        m_roleNames[GriloModel::MediaRole + m_keyCount] = metadataKey;
+
+        QStringList splitKey = QString(metadataKey).split("-", QString::SkipEmptyParts);
+        if (splitKey.length() > 1) {
+            QByteArray camelCaseKey = splitKey[0].toUtf8();
+
+            for (int i = 1; i < splitKey.length(); i++) {
+                QString camelCase = splitKey[i];
+                camelCase[0] = camelCase[0].toUpper();
+                camelCaseKey += camelCase.toUtf8();
+            }
+
+            m_roleNames.insertMulti(GriloModel::MediaRole + m_keyCount, camelCaseKey);
+        }
+    }
+}
+
 GriloModel::GriloModel(QObject *parent)
     : QAbstractListModel(parent)
-    , d(new GriloModelPrivate)
+    , d(new GriloModelPrivate(this))
 {
-    d->m_source = nullptr;
     QObject::connect(this, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
                      this, SIGNAL(countChanged()));
     QObject::connect(this, SIGNAL(rowsRemoved(const QModelIndex &, int, int)),
                      this, SIGNAL(countChanged()));
+    QObject::connect(this, SIGNAL(modelReset()),
+                     this, SIGNAL(countChanged()));
 }
 
 GriloModel::~GriloModel()
@@ -55,7 +140,7 @@ GriloModel::~GriloModel()
 int GriloModel::rowCount(const QModelIndex &parent) const
 {
     if (!parent.isValid()) {
-        return d->m_source ? d->m_source->media()->count() : 0;
+        return d->filtered() ? d->m_rows.count() : d->m_sourceCount;
     }
 
     return 0;
@@ -67,13 +152,18 @@ QVariant GriloModel::data(const QModelIndex &index, int role) const
         return QVariant();
     }
 
+    int row = d->sourceRow(index.row());
+
     switch (role) {
     case MediaRole:
-        return QVariant::fromValue(d->m_source->media()->at(index.row()));
+        return QVariant::fromValue(d->m_source->mediaAt(row));
     default: {
-        QList<QByteArray> keys = roleNames().values(role);
-        if (keys.length() > 0) {
-            return d->m_source->media()->at(index.row())->get(role - MediaRole);
+        int key = role - MediaRole;
+        if (key > d->m_keyCount) {
+            d->updateRoleNames();
+        }
+        if (key > 0 && key <= d->m_keyCount) {
+            return d->m_source->mediaValue(row, key);
         }
     }
     }
@@ -81,6 +171,18 @@ QVariant GriloModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
+bool GriloModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && d->m_source && d->m_source->canFetchMore();
+}
+
+void GriloModel::fetchMore(const QModelIndex &parent)
+{
+    if (!parent.isValid() && d->m_source) {
+        d->m_source->fetchMore();
+    }
+}
+
 GriloDataSource *GriloModel::source() const
 {
     return d->m_source;
@@ -102,8 +204,13 @@ void GriloModel::setSource(GriloDataSource *source)
 
     if (d->m_source) {
         d->m_source->addModel(this);
+        d->m_source->setFilters(this, d->m_filters);
     }
 
+    // The rows already in the source are added by prefill()
+    d->m_sourceCount = 0;
+    d->m_rows.clear();
+
     endResetModel();
 
     Q_EMIT sourceChanged();
@@ -120,38 +227,213 @@ int GriloModel::count() const
 
 QHash<int, QByteArray> GriloModel::roleNames() const
 {
-    if (d->m_roleNames.isEmpty())
-        grl_init(0, 0);
+    d->updateRoleNames();
 
-    d->m_roleNames[MediaRole] = "media";
+    return d->m_roleNames;
+}
 
-    int cursor = GRL_METADATA_KEY_INVALID;
+GriloMedia* GriloModel::getMediaItem(int index)
+{
+    if (index < 0 || index >= rowCount()) {
+        return nullptr;
+    }
 
-    while (const char *metadataKey = GRL_METADATA_KEY_GET_NAME(++cursor)) {
-        d->m_roleNames[MediaRole + cursor] = metadataKey;
+    return d->m_source->mediaAt(d->sourceRow(index));
+}
 
-        QStringList splitKey = QString(metadataKey).split("-", QString::SkipEmptyParts);
-        if (splitKey.length() > 1) {
-            QByteArray camelCaseKey = splitKey[0].toUtf8();
+QVariantList GriloModel::filters() const
+{
+    return d->m_filters;
+}
 
-            for (int i = 1; i < splitKey.length(); i++) {
-                QString camelCase = splitKey[i];
-                camelCase[0] = camelCase[0].toUpper();
-                camelCaseKey += camelCase.toUtf8();
-            }
+void GriloModel::setFilters(const QVariantList &filters)
+{
+    if (d->m_filters == filters) {
+        return;
+    }
+
+    beginResetModel();
+    d->m_filters = filters;
+    if (d->m_source) {
+        d->m_source->setFilters(this, d->m_filters);
+    }
+    d->rebuild();
+    endResetModel();
 
-            d->m_roleNames.insertMulti(MediaRole + cursor, camelCaseKey);
+    Q_EMIT filtersChanged();
+}
+
+void GriloModel::sourceRowsAboutToBeInserted(int first, int last)
+{
+    d->m_first = first;
+    d->m_last = last;
+
+    if (!d->filtered()) {
+        beginInsertRows(QModelIndex(), first, last);
+    }
+}
+
+void GriloModel::sourceRowsInserted()
+{
+    int inserted = d->m_last - d->m_first + 1;
+    d->m_sourceCount += inserted;
+
+    if (!d->filtered()) {
+        endInsertRows();
+        return;
+    }
+
+    int row = d->lowerBound(d->m_first);
+    for (int i = row; i < d->m_rows.count(); ++i) {
+        d->m_rows[i] += inserted;
+    }
+
+    QVector<int> matching = d->m_source->matchingRows(this, d->m_first, d->m_last);
+    if (!matching.isEmpty()) {
+        beginInsertRows(QModelIndex(), row, row + matching.count() - 1);
+        d->m_rows.insert(row, matching.count(), 0);
+        std::copy(matching.constBegin(), matching.constEnd(), d->m_rows.begin() + row);
+        endInsertRows();
+    }
+}
+
+void GriloModel::sourceRowsAboutToBeRemoved(int first, int last)
+{
+    d->m_first = first;
+    d->m_last = last;
+
+    if (!d->filtered()) {
+        beginRemoveRows(QModelIndex(), first, last);
+        return;
+    }
+
+    d->m_proxyFirst = d->lowerBound(first);
+    d->m_proxyLast = d->lowerBound(last + 1) - 1;
+    if (d->m_proxyLast >= d->m_proxyFirst) {
+        beginRemoveRows(QModelIndex(), d->m_proxyFirst, d->m_proxyLast);
+    }
+}
+
+void GriloModel::sourceRowsRemoved()
+{
+    int removed = d->m_last - d->m_first + 1;
+    d->m_sourceCount -= removed;
+
+    if (!d->filtered()) {
+        endRemoveRows();
+        return;
+    }
+
+    bool shown = d->m_proxyLast >= d->m_proxyFirst;
+    if (shown) {
+        d->m_rows.remove(d->m_proxyFirst, d->m_proxyLast - d->m_proxyFirst + 1);
+    }
+    for (int i = d->m_proxyFirst; i < d->m_rows.count(); ++i) {
+        d->m_rows[i] -= removed;
+    }
+
+    if (shown) {
+        endRemoveRows();
+    }
+}
+
+void GriloModel::sourceRowAboutToBeMoved(int row, int destination)
+{
+    // Position of the row once moved
+    d->m_first = row;
+    d->m_last = destination > row ? destination - 1 : destination;
+    d->m_moving = false;
+
+    if (!d->filtered()) {
+        d->m_moving = beginMoveRows(QModelIndex(), row, row, QModelIndex(), destination);
+        return;
+    }
+
+    int from = d->lowerBound(row);
+    if (from == d->m_rows.count() || d->m_rows.at(from) != row) {
+        d->m_proxyFirst = -1;
+        return;
+    }
+
+    // Rows shown before the new position, not counting the moved one
+    int to = d->m_last < row ? d->lowerBound(d->m_last) : d->lowerBound(d->m_last + 1) - 1;
+    d->m_proxyFirst = from;
+    d->m_proxyLast = to;
+
+    if (to != from) {
+        d->m_moving = beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+    }
+}
+
+void GriloModel::sourceRowMoved()
+{
+    if (d->filtered()) {
+        int row = d->m_first;
+        int to = d->m_last;
+
+        if (d->m_proxyFirst != -1) {
+            d->m_rows.remove(d->m_proxyFirst);
+        }
+
+        // Only the rows between the old and the new position shift.
+        int first = d->lowerBound(qMin(row, to));
+        int last = d->lowerBound(qMax(row, to) + 1);
+        for (int i = first; i < last; ++i) {
+            d->m_rows[i] += row < to ? -1 : 1;
+        }
+
+        if (d->m_proxyFirst != -1) {
+            d->m_rows.insert(d->m_proxyLast, to);
         }
     }
 
-    return d->m_roleNames;
+    if (d->m_moving) {
+        endMoveRows();
+    }
 }
 
-GriloMedia* GriloModel::getMediaItem(int index)
+void GriloModel::sourceRowsChanged(int first, int last)
 {
-    if (index < 0 || index >= rowCount()) {
-        return nullptr;
+    if (!d->filtered()) {
+        Q_EMIT dataChanged(index(first, 0), index(last, 0));
+        return;
+    }
+
+    // A changed row may start or stop matching.
+    QVector<int> matching = d->m_source->matchingRows(this, first, last);
+    int next = 0;
+
+    for (int source = first; source <= last; ++source) {
+        bool matches = next < matching.count() && matching.at(next) == source;
+        if (matches) {
+            ++next;
+        }
+
+        int row = d->lowerBound(source);
+        bool shown = row < d->m_rows.count() && d->m_rows.at(row) == source;
+
+        if (shown && matches) {
+            QModelIndex modelIndex = index(row, 0);
+            Q_EMIT dataChanged(modelIndex, modelIndex);
+        } else if (shown) {
+            beginRemoveRows(QModelIndex(), row, row);
+            d->m_rows.remove(row);
+            endRemoveRows();
+        } else if (matches) {
+            beginInsertRows(QModelIndex(), row, row);
+            d->m_rows.insert(row, source);
+            endInsertRows();
+        }
     }
+}
 
-    return d->m_source->media()->at(index);
+void GriloModel::sourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void GriloModel::sourceReset()
+{
+    d->rebuild();
+    endResetModel();
 }
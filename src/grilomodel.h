@@ -39,6 +39,7 @@ class GRILO_QT_EXPORT GriloModel : public QAbstractListModel
     Q_OBJECT
     Q_PROPERTY(GriloDataSource *source READ source WRITE setSource NOTIFY sourceChanged)
     Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(QVariantList filters READ filters WRITE setFilters NOTIFY filtersChanged)
 
     friend class GriloDataSource;
 
@@ -55,18 +56,40 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+
     GriloDataSource *source() const;
     void setSource(GriloDataSource *source);
 
     int count() const;
 
+    // Rows are shown when they match all the filters. A filter is a map with
+    // either "mediaType" set to a media type or a list of them, or "key" set
+    // to a metadata key together with "min" and/or "max", "prefix" or
+    // "value"/"values". Text is compared case sensitively.
+    QVariantList filters() const;
+    void setFilters(const QVariantList &filters);
+
     Q_INVOKABLE GriloMedia* getMediaItem(int index);
 
 Q_SIGNALS:
     void sourceChanged();
     void countChanged();
+    void filtersChanged();
 
 private:
+    // Changes of the source rows, called by GriloDataSource
+    void sourceRowsAboutToBeInserted(int first, int last);
+    void sourceRowsInserted();
+    void sourceRowsAboutToBeRemoved(int first, int last);
+    void sourceRowsRemoved();
+    void sourceRowAboutToBeMoved(int row, int destination);
+    void sourceRowMoved();
+    void sourceRowsChanged(int first, int last);
+    void sourceAboutToBeReset();
+    void sourceReset();
+
     GriloModelPrivate *d;
 };
 
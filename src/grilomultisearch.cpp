@@ -21,16 +21,53 @@
 
 #include "grilomultisearch.h"
 #include "griloregistry.h"
+#include "grilotrace.h"
 
 #include <QDebug>
+#include <QTimerEvent>
+
+// Search on one of the sources when searching them in parallel. Deleted by
+// the last callback of the operation, which is also called on cancel.
+struct GriloSourceSearch
+{
+    GriloMultiSearch *search;
+    guint opId;
+    // Position in sources, the priority of the source
+    int source;
+    int budget;
+    int received;
+    int timerId;
+};
 
 class GriloMultiSearchPrivate
 {
 public:
+    GriloMultiSearchPrivate();
+
     QStringList m_sources;
     QString m_text;
+
+    bool m_parallel;
+    int m_mergePolicy;
+    int m_sortKey;
+    QVariantMap m_sourceCounts;
+    QVariantMap m_sourceTimeouts;
+
+    QList<GriloSourceSearch *> m_searches;
+    // Rows of the previous search are dropped with the first new result.
+    bool m_replaced;
+    bool m_succeeded;
 };
 
+GriloMultiSearchPrivate::GriloMultiSearchPrivate()
+    : m_parallel(false)
+    , m_mergePolicy(GriloMultiSearch::RoundRobin)
+    , m_sortKey(GRL_METADATA_KEY_TITLE)
+    , m_replaced(false)
+    , m_succeeded(false)
+{
+}
+
 GriloMultiSearch::GriloMultiSearch(QObject *parent)
     : GriloDataSource(parent)
     , d(new GriloMultiSearchPrivate)
@@ -39,19 +76,55 @@ GriloMultiSearch::GriloMultiSearch(QObject *parent)
 
 GriloMultiSearch::~GriloMultiSearch()
 {
+    // The base class can only cancel the operations it knows about.
+    cancelRefresh();
     delete d;
 }
 
 bool GriloMultiSearch::refresh()
 {
+    if (deferRefresh()) {
+        return true;
+    }
+
     cancelRefresh();
 
+    if (followSharedResults()) {
+        return true;
+    }
+
+    loadCache();
+
+    return startOperation();
+}
+
+QString GriloMultiSearch::operationKey() const
+{
+    QString key = QString::fromLatin1("multisearch|%1|%2").arg(d->m_sources.join(QLatin1Char(',')), d->m_text);
+
+    if (d->m_parallel) {
+        key += QString::fromLatin1("|%1|%2").arg(d->m_mergePolicy).arg(d->m_sortKey);
+        Q_FOREACH (const QString &source, d->m_sources) {
+            key += QString::fromLatin1("|%1:%2").arg(d->m_sourceCounts.value(source).toInt())
+                    .arg(d->m_sourceTimeouts.value(source).toInt());
+        }
+    }
+
+    return key;
+}
+
+bool GriloMultiSearch::startOperation()
+{
     GriloRegistry *registry = getGriloRegistry();
     if (!registry) {
         qWarning() << "GriloRegistry not set";
         return false;
     }
 
+    if (d->m_parallel) {
+        return startSearches(registry);
+    }
+
     GList *sources = NULL;
 
     Q_FOREACH (const QString &src, d->m_sources) {
@@ -69,6 +142,7 @@ bool GriloMultiSearch::refresh()
     setFetching(true);
     guint opId = grl_multiple_search(sources, d->m_text.toUtf8().constData(),
                                      keys, options, grilo_source_result_cb, this);
+    GRILO_TRACE_INSTANT_ARG("multisearch", "operation", opId);
 
     setOpId(opId);
     g_list_free(sources);
@@ -79,6 +153,241 @@ bool GriloMultiSearch::refresh()
     return opId != 0;
 }
 
+bool GriloMultiSearch::startSearches(GriloRegistry *registry)
+{
+    d->m_replaced = false;
+    d->m_succeeded = false;
+
+    GList *keys = keysAsList();
+    QByteArray text = d->m_text.toUtf8();
+
+    for (int i = 0; i < d->m_sources.count(); ++i) {
+        const QString &id = d->m_sources.at(i);
+        GrlSource *src = registry->lookupSource(id);
+        if (!src) {
+            qWarning() << "Failed to obtain source for" << id;
+            continue;
+        }
+
+        GrlOperationOptions *options = operationOptions(src, Search);
+
+        GriloSourceSearch *search = new GriloSourceSearch;
+        search->search = this;
+        search->source = i;
+        search->budget = d->m_sourceCounts.value(id, count()).toInt();
+        search->received = 0;
+        search->timerId = 0;
+        if (search->budget > 0) {
+            grl_operation_options_set_count(options, search->budget);
+        }
+
+        d->m_searches.append(search);
+        search->opId = grl_source_search(src, text.constData(), keys, options,
+                                         grilo_source_search_cb, search);
+        GRILO_TRACE_INSTANT_ARG("search", "operation", search->opId);
+        g_object_unref(options);
+
+        if (search->opId == 0) {
+            d->m_searches.removeOne(search);
+            delete search;
+            continue;
+        }
+
+        int timeout = d->m_sourceTimeouts.value(id, 0).toInt();
+        if (timeout > 0) {
+            search->timerId = startTimer(timeout);
+        }
+    }
+
+    g_list_free(keys);
+
+    if (d->m_searches.isEmpty()) {
+        return false;
+    }
+
+    setFetching(true);
+    // The id only tells there is an operation running, results go through insertResult().
+    setOpId(d->m_searches.first()->opId, false);
+
+    return true;
+}
+
+void GriloMultiSearch::grilo_source_search_cb(GrlSource *source, guint op_id,
+                                              GrlMedia *media, guint remaining,
+                                              gpointer user_data, const GError *error)
+{
+    Q_UNUSED(source)
+    Q_UNUSED(op_id)
+    GRILO_TRACE_SCOPE("searchResult");
+    GriloSourceSearch *search = static_cast<GriloSourceSearch *>(user_data);
+
+    if (error) {
+        if (error->domain != GRL_CORE_ERROR || error->code != GRL_CORE_ERROR_OPERATION_CANCELLED) {
+            qCritical() << "Operation failed" << error->message;
+        } else {
+            // Cancelled or timed out, the instance might be deleted already
+            if (media) {
+                g_object_unref(media);
+            }
+            if (remaining == 0) {
+                delete search;
+            }
+            return;
+        }
+    }
+
+    GriloMultiSearch *that = search->search;
+
+    if (media) {
+        that->insertResult(search, media);
+    }
+
+    if (remaining == 0) {
+        that->searchFinished(search, error != 0);
+        delete search;
+    }
+}
+
+void GriloMultiSearch::insertResult(GriloSourceSearch *search, GrlMedia *media)
+{
+    if (search->budget > 0 && search->received >= search->budget) {
+        g_object_unref(media);
+        return;
+    }
+
+    if (!d->m_replaced) {
+        clearMedia();
+        d->m_replaced = true;
+    }
+
+    // Sources take turns, or the results of a source go after those of the
+    // sources before it. Equal values of the sort key take turns too.
+    qint64 received = search->received++;
+    qint64 order = d->m_mergePolicy == SourcePriority
+            ? (qint64(search->source) << 32) + received
+            : received * d->m_sources.count() + search->source;
+
+    mergeMedia(media, d->m_mergePolicy == SortKey ? d->m_sortKey : 0, order);
+}
+
+void GriloMultiSearch::searchFinished(GriloSourceSearch *search, bool failed)
+{
+    if (search->timerId != 0) {
+        killTimer(search->timerId);
+        search->timerId = 0;
+    }
+
+    d->m_searches.removeOne(search);
+    d->m_succeeded = d->m_succeeded || !failed;
+
+    if (d->m_searches.isEmpty()) {
+        if (!d->m_replaced) {
+            // Nothing found anywhere
+            clearMedia();
+            d->m_replaced = true;
+        }
+        finishOperation(!d->m_succeeded);
+    }
+}
+
+void GriloMultiSearch::cancelOperation()
+{
+    if (d->m_searches.isEmpty()) {
+        GriloDataSource::cancelOperation();
+        return;
+    }
+
+    // The structs go with the cancel callbacks.
+    Q_FOREACH (GriloSourceSearch *search, d->m_searches) {
+        if (search->timerId != 0) {
+            killTimer(search->timerId);
+        }
+        grl_operation_cancel(search->opId);
+    }
+    d->m_searches.clear();
+}
+
+void GriloMultiSearch::timerEvent(QTimerEvent *event)
+{
+    Q_FOREACH (GriloSourceSearch *search, d->m_searches) {
+        if (search->timerId == event->timerId()) {
+            // A slow source does not hold back the others any longer.
+            qWarning() << "Search on" << d->m_sources.value(search->source) << "timed out";
+            guint opId = search->opId;
+            searchFinished(search, true);
+            grl_operation_cancel(opId);
+            return;
+        }
+    }
+
+    GriloDataSource::timerEvent(event);
+}
+
+bool GriloMultiSearch::parallel() const
+{
+    return d->m_parallel;
+}
+
+void GriloMultiSearch::setParallel(bool parallel)
+{
+    if (d->m_parallel != parallel) {
+        d->m_parallel = parallel;
+        Q_EMIT parallelChanged();
+    }
+}
+
+int GriloMultiSearch::mergePolicy() const
+{
+    return d->m_mergePolicy;
+}
+
+void GriloMultiSearch::setMergePolicy(int policy)
+{
+    if (d->m_mergePolicy != policy) {
+        d->m_mergePolicy = policy;
+        Q_EMIT mergePolicyChanged();
+    }
+}
+
+int GriloMultiSearch::sortKey() const
+{
+    return d->m_sortKey;
+}
+
+void GriloMultiSearch::setSortKey(int key)
+{
+    if (d->m_sortKey != key) {
+        d->m_sortKey = key;
+        Q_EMIT sortKeyChanged();
+    }
+}
+
+QVariantMap GriloMultiSearch::sourceCounts() const
+{
+    return d->m_sourceCounts;
+}
+
+void GriloMultiSearch::setSourceCounts(const QVariantMap &counts)
+{
+    if (d->m_sourceCounts != counts) {
+        d->m_sourceCounts = counts;
+        Q_EMIT sourceCountsChanged();
+    }
+}
+
+QVariantMap GriloMultiSearch::sourceTimeouts() const
+{
+    return d->m_sourceTimeouts;
+}
+
+void GriloMultiSearch::setSourceTimeouts(const QVariantMap &timeouts)
+{
+    if (d->m_sourceTimeouts != timeouts) {
+        d->m_sourceTimeouts = timeouts;
+        Q_EMIT sourceTimeoutsChanged();
+    }
+}
+
 QStringList GriloMultiSearch::sources() const
 {
     return d->m_sources;
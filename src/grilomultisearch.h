@@ -28,16 +28,32 @@
 #include <GriloDataSource>
 
 #include <QStringList>
+#include <QVariantMap>
 
 class GriloMultiSearchPrivate;
+class GriloRegistry;
+struct GriloSourceSearch;
 
 class GRILO_QT_EXPORT GriloMultiSearch : public GriloDataSource
 {
     Q_OBJECT
     Q_PROPERTY(QStringList sources READ sources WRITE setSources NOTIFY sourcesChanged)
     Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
+    Q_PROPERTY(bool parallel READ parallel WRITE setParallel NOTIFY parallelChanged)
+    Q_PROPERTY(int mergePolicy READ mergePolicy WRITE setMergePolicy NOTIFY mergePolicyChanged)
+    Q_PROPERTY(int sortKey READ sortKey WRITE setSortKey NOTIFY sortKeyChanged)
+    Q_PROPERTY(QVariantMap sourceCounts READ sourceCounts WRITE setSourceCounts NOTIFY sourceCountsChanged)
+    Q_PROPERTY(QVariantMap sourceTimeouts READ sourceTimeouts WRITE setSourceTimeouts NOTIFY sourceTimeoutsChanged)
+
+    Q_ENUMS(MergePolicy)
 
 public:
+    enum MergePolicy {
+        RoundRobin,
+        SourcePriority,
+        SortKey,
+    };
+
     GriloMultiSearch(QObject *parent = 0);
     ~GriloMultiSearch();
 
@@ -49,11 +65,52 @@ public:
     QString text() const;
     void setText(const QString &text);
 
+    // When enabled every source is searched with an operation of its own and
+    // the results are inserted as they arrive, ordered by mergePolicy: taking
+    // turns between the sources, by the order of sources or by the value of
+    // sortKey. The rows of the previous search go with the first new result.
+    bool parallel() const;
+    void setParallel(bool parallel);
+
+    int mergePolicy() const;
+    void setMergePolicy(int policy);
+
+    int sortKey() const;
+    void setSortKey(int key);
+
+    // Results wanted from a source, by source id. Defaults to count.
+    QVariantMap sourceCounts() const;
+    void setSourceCounts(const QVariantMap &counts);
+
+    // Milliseconds a source may take, by source id. The results so far are kept.
+    QVariantMap sourceTimeouts() const;
+    void setSourceTimeouts(const QVariantMap &timeouts);
+
 Q_SIGNALS:
     void sourcesChanged();
     void textChanged();
+    void parallelChanged();
+    void mergePolicyChanged();
+    void sortKeyChanged();
+    void sourceCountsChanged();
+    void sourceTimeoutsChanged();
+
+protected:
+    void cancelOperation();
+    void timerEvent(QTimerEvent *event);
 
 private:
+    bool startOperation();
+    QString operationKey() const;
+
+    static void grilo_source_search_cb(GrlSource *source, guint op_id,
+                                       GrlMedia *media, guint remaining,
+                                       gpointer user_data, const GError *error);
+
+    bool startSearches(GriloRegistry *registry);
+    void insertResult(GriloSourceSearch *search, GrlMedia *media);
+    void searchFinished(GriloSourceSearch *search, bool failed);
+
     GriloMultiSearchPrivate *d;
 };
 
@@ -21,6 +21,7 @@
 
 #include "griloquery.h"
 #include "griloregistry.h"
+#include "grilotrace.h"
 
 #include <QDebug>
 
@@ -48,7 +49,28 @@ GriloQuery::~GriloQuery()
 
 bool GriloQuery::refresh()
 {
+    if (deferRefresh()) {
+        return true;
+    }
+
     cancelRefresh();
+
+    if (followSharedResults()) {
+        return true;
+    }
+
+    loadCache();
+
+    return startOperation();
+}
+
+QString GriloQuery::operationKey() const
+{
+    return QString::fromLatin1("query|%1|%2").arg(d->m_source, d->m_query);
+}
+
+bool GriloQuery::startOperation()
+{
     GriloRegistry *registry = getGriloRegistry();
 
     if (!registry) {
@@ -68,11 +90,12 @@ bool GriloQuery::refresh()
         return false;
     }
 
-    GList *keys = keysAsList();
+    GList *keys = keysAsList(src);
     GrlOperationOptions *options = operationOptions(src, Search);
     setFetching(true);
     guint opId = grl_source_query(src, d->m_query.toUtf8().constData(),
                                   keys, options, grilo_source_result_cb, this);
+    GRILO_TRACE_INSTANT_ARG("query", "operation", opId);
     setOpId(opId);
 
     g_object_unref(options);
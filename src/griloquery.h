@@ -64,6 +64,8 @@ Q_SIGNALS:
     void availabilityChanged();
 
 private:
+    bool startOperation();
+    QString operationKey() const;
     void contentChanged(const QString &source, GrlSourceChangeType change_type,
                         GPtrArray *changed_media);
     void availableSourcesChanged();
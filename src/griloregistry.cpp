@@ -22,6 +22,10 @@
  */
 
 #include "griloregistry.h"
+#include "grilomedia.h"
+#include "grilodatasource.h"
+#include "grilotrace.h"
+
 #include <QDebug>
 
 class GriloRegistryPrivate
@@ -159,11 +163,12 @@ void GriloRegistry::grilo_content_changed_cb(GrlSource *source, GPtrArray *chang
                                              GrlSourceChangeType change_type, gboolean location_unknown,
                                              gpointer user_data)
 {
-    Q_UNUSED(location_unknown);
     GriloRegistry *reg = static_cast<GriloRegistry *>(user_data);
 
+    GRILO_TRACE_INSTANT_ARG("contentChanged", "items", changed_media ? changed_media->len : 0);
+
     const char *id = grl_source_get_id(source);
-    Q_EMIT reg->contentChanged(id, change_type, changed_media);
+    Q_EMIT reg->contentChanged(id, change_type, changed_media, location_unknown);
 }
 
 GrlSource *GriloRegistry::lookupSource(const QString &id)
@@ -175,3 +180,23 @@ GrlSource *GriloRegistry::lookupSource(const QString &id)
 
     return grl_registry_lookup_source(d->m_registry, id.toUtf8().constData());
 }
+
+quint32 GriloRegistry::metadataKey(const QString &name) const
+{
+    return GriloMedia::keyId(name);
+}
+
+int GriloRegistry::sharedResultsLimit() const
+{
+    return GriloDataSource::sharedResultsLimit();
+}
+
+void GriloRegistry::setSharedResultsLimit(int rows)
+{
+    rows = qMax(0, rows);
+
+    if (GriloDataSource::sharedResultsLimit() != rows) {
+        GriloDataSource::setSharedResultsLimit(rows);
+        Q_EMIT sharedResultsLimitChanged();
+    }
+}
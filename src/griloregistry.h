@@ -41,6 +41,7 @@ class GRILO_QT_EXPORT GriloRegistry : public QObject
 
     Q_PROPERTY(QStringList availableSources READ availableSources NOTIFY availableSourcesChanged)
     Q_PROPERTY(QString configurationFile READ configurationFile WRITE setConfigurationFile NOTIFY configurationFileChanged)
+    Q_PROPERTY(int sharedResultsLimit READ sharedResultsLimit WRITE setSharedResultsLimit NOTIFY sharedResultsLimitChanged)
 
 public:
     GriloRegistry(QObject *parent = 0);
@@ -54,14 +55,23 @@ public:
 
     GrlSource *lookupSource(const QString &id);
 
+    // Resolves a metadata key name like "album-artist" once so that
+    // GriloMedia::get() can be called with the numeric id afterwards.
+    Q_INVOKABLE quint32 metadataKey(const QString &name) const;
+
     QString configurationFile() const;
     void setConfigurationFile(const QString &file);
 
+    // Process wide, see GriloDataSource::sharedResults
+    int sharedResultsLimit() const;
+    void setSharedResultsLimit(int rows);
+
 Q_SIGNALS:
     void availableSourcesChanged();
     void configurationFileChanged();
+    void sharedResultsLimitChanged();
     void contentChanged(const QString &source, GrlSourceChangeType change_type,
-                        GPtrArray *changed_media);
+                        GPtrArray *changed_media, bool location_unknown = false);
 
 private:
     static void connect_source(gpointer data, gpointer user_data);
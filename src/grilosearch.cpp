@@ -21,6 +21,7 @@
 
 #include "grilosearch.h"
 #include "griloregistry.h"
+#include "grilotrace.h"
 
 #include <QDebug>
 
@@ -33,6 +34,10 @@ public:
     QVariantList m_slowKeys;
     QVariantList m_supportedKeys;
     bool m_available = false;
+
+    bool m_localRefinement = false;
+    // Text the rows are the results for
+    QString m_resultsText;
 };
 
 GriloSearch::GriloSearch(QObject *parent)
@@ -48,8 +53,28 @@ GriloSearch::~GriloSearch()
 
 bool GriloSearch::refresh()
 {
+    if (deferRefresh()) {
+        return true;
+    }
+
     cancelRefresh();
 
+    if (followSharedResults()) {
+        return true;
+    }
+
+    loadCache();
+
+    return startOperation();
+}
+
+QString GriloSearch::operationKey() const
+{
+    return QString::fromLatin1("search|%1|%2").arg(d->m_source, d->m_text);
+}
+
+bool GriloSearch::startOperation()
+{
     GriloRegistry *registry = getGriloRegistry();
     if (!registry) {
         qWarning() << "GriloRegistry not set";
@@ -68,11 +93,14 @@ bool GriloSearch::refresh()
         return false;
     }
 
-    GList *keys = keysAsList();
+    d->m_resultsText = d->m_text;
+
+    GList *keys = keysAsList(src);
     GrlOperationOptions *options = operationOptions(src, Search);
     setFetching(true);
     guint opId = grl_source_search(src, d->m_text.toUtf8().constData(),
                                    keys, options, grilo_source_result_cb, this);
+    GRILO_TRACE_INSTANT_ARG("search", "operation", opId);
     setOpId(opId);
 
     g_object_unref(options);
@@ -105,10 +133,34 @@ void GriloSearch::setText(const QString &text)
 {
     if (d->m_text != text) {
         d->m_text = text;
+
+        if (d->m_localRefinement && !d->m_resultsText.isEmpty() && text != d->m_resultsText
+                && text.contains(d->m_resultsText, Qt::CaseInsensitive)) {
+            // A running search for the previous text would only add rows back.
+            // The refresh for the new text keeps waiting for its quiet period.
+            stopOperation();
+            if (retainMatchingRows(text) != -1) {
+                d->m_resultsText = text;
+            }
+        }
+
         Q_EMIT textChanged();
     }
 }
 
+bool GriloSearch::localRefinement() const
+{
+    return d->m_localRefinement;
+}
+
+void GriloSearch::setLocalRefinement(bool enabled)
+{
+    if (d->m_localRefinement != enabled) {
+        d->m_localRefinement = enabled;
+        Q_EMIT localRefinementChanged();
+    }
+}
+
 QVariantList GriloSearch::supportedKeys() const
 {
     GriloRegistry *registry = getGriloRegistry();
@@ -37,6 +37,7 @@ class GRILO_QT_EXPORT GriloSearch : public GriloDataSource
     Q_PROPERTY(QVariantList supportedKeys READ supportedKeys NOTIFY supportedKeysChanged)
     Q_PROPERTY(QVariantList slowKeys READ slowKeys NOTIFY slowKeysChanged)
     Q_PROPERTY(bool available READ isAvailable NOTIFY availabilityChanged)
+    Q_PROPERTY(bool localRefinement READ localRefinement WRITE setLocalRefinement NOTIFY localRefinementChanged)
 
 public:
     GriloSearch(QObject *parent = 0);
@@ -50,6 +51,12 @@ public:
     QString text() const;
     void setText(const QString &text);
 
+    // When enabled and the text is changed to one containing the text of the
+    // current results, rows not matching it are removed right away. The next
+    // refresh() brings the actual results.
+    bool localRefinement() const;
+    void setLocalRefinement(bool enabled);
+
     QVariantList supportedKeys() const;
     QVariantList slowKeys() const;
 
@@ -58,11 +65,14 @@ public:
 Q_SIGNALS:
     void sourceChanged();
     void textChanged();
+    void localRefinementChanged();
     void supportedKeysChanged();
     void slowKeysChanged();
     void availabilityChanged();
 
 private:
+    bool startOperation();
+    QString operationKey() const;
     void availableSourcesChanged();
 
     GriloSearchPrivate *d;
@@ -0,0 +1,118 @@
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "grilotrace.h"
+
+#ifdef GRILO_QT_TRACING
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+#include <glib.h>
+
+// Writes the events as a JSON array. The array is never closed, the trace
+// viewers accept that so the file stays usable when the process dies.
+class GriloTraceWriter
+{
+public:
+    GriloTraceWriter()
+        : m_pid(QCoreApplication::applicationPid())
+    {
+        QByteArray path = qgetenv("GRILO_QT_TRACE");
+        if (path.isEmpty()) {
+            return;
+        }
+
+        m_file.setFileName(QFile::decodeName(path));
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Failed to open trace file" << m_file.fileName();
+            return;
+        }
+
+        m_file.write("[\n");
+    }
+
+    bool isEnabled() const
+    {
+        return m_file.isOpen();
+    }
+
+    // CLOCK_MONOTONIC microseconds, the clock of Tracker and compositor
+    // traces, so the files can be viewed side by side
+    qint64 now() const
+    {
+        return g_get_monotonic_time();
+    }
+
+    void write(const char *name, char phase, qint64 timestamp, qint64 duration,
+               const char *argName, qint64 arg)
+    {
+        QByteArray event = "{\"name\":\"" + QByteArray(name) + "\",\"cat\":\"grilo\",\"ph\":\"" + phase
+                + "\",\"ts\":" + QByteArray::number(timestamp)
+                + ",\"pid\":" + QByteArray::number(m_pid)
+                + ",\"tid\":" + QByteArray::number(quintptr(QThread::currentThreadId()));
+        if (phase == 'X') {
+            event += ",\"dur\":" + QByteArray::number(duration);
+        } else {
+            event += ",\"s\":\"t\"";
+        }
+        if (argName) {
+            event += ",\"args\":{\"" + QByteArray(argName) + "\":" + QByteArray::number(arg) + "}";
+        }
+        event += "},\n";
+
+        QMutexLocker locker(&m_mutex);
+        m_file.write(event);
+        m_file.flush();
+    }
+
+private:
+    QFile m_file;
+    QMutex m_mutex;
+    qint64 m_pid;
+};
+
+Q_GLOBAL_STATIC(GriloTraceWriter, traceWriter)
+
+void GriloTrace::instant(const char *name, const char *argName, qint64 arg)
+{
+    GriloTraceWriter *writer = traceWriter();
+    if (writer->isEnabled()) {
+        writer->write(name, 'i', writer->now(), 0, argName, arg);
+    }
+}
+
+qint64 GriloTrace::begin()
+{
+    GriloTraceWriter *writer = traceWriter();
+    return writer->isEnabled() ? writer->now() : 0;
+}
+
+void GriloTrace::end(const char *name, qint64 start)
+{
+    GriloTraceWriter *writer = traceWriter();
+    if (writer->isEnabled()) {
+        writer->write(name, 'X', start, writer->now() - start, 0, 0);
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+// -*- c++ -*-
+
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GRILO_TRACE_H
+#define GRILO_TRACE_H
+
+// Trace points, only built with GRILO_QT_TRACING defined (qmake CONFIG+=grilo_tracing).
+// The events are written in the Chrome trace event format, which perfetto and
+// chrome://tracing open, to the file named by the GRILO_QT_TRACE environment
+// variable. Nothing is written when it is not set.
+
+#ifdef GRILO_QT_TRACING
+
+#include <QtGlobal>
+
+class GriloTrace
+{
+public:
+    // Event at one point in time with an optional integer argument
+    static void instant(const char *name, const char *argName = 0, qint64 arg = 0);
+    // Event lasting from begin() to end(), as written by GriloTraceScope
+    static qint64 begin();
+    static void end(const char *name, qint64 start);
+};
+
+class GriloTraceScope
+{
+public:
+    explicit GriloTraceScope(const char *name)
+        : m_name(name)
+        , m_start(GriloTrace::begin())
+    {
+    }
+
+    ~GriloTraceScope()
+    {
+        GriloTrace::end(m_name, m_start);
+    }
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+#define GRILO_TRACE_CONCAT_(a, b) a##b
+#define GRILO_TRACE_CONCAT(a, b) GRILO_TRACE_CONCAT_(a, b)
+
+#define GRILO_TRACE_INSTANT(name) GriloTrace::instant(name)
+#define GRILO_TRACE_INSTANT_ARG(name, argName, arg) GriloTrace::instant(name, argName, arg)
+#define GRILO_TRACE_SCOPE(name) GriloTraceScope GRILO_TRACE_CONCAT(griloTraceScope, __LINE__)(name)
+
+#else
+
+#define GRILO_TRACE_INSTANT(name) do {} while (0)
+#define GRILO_TRACE_INSTANT_ARG(name, argName, arg) do {} while (0)
+#define GRILO_TRACE_SCOPE(name) do {} while (0)
+
+#endif
+
+#endif /* GRILO_TRACE_H */
@@ -11,6 +11,9 @@ QMAKE_SUBSTITUTES = $${TARGET}.prf.in
 
 DEFINES += GRILO_QT_LIBRARY
 
+# qmake CONFIG+=grilo_tracing builds in the trace points, see grilotrace.h
+grilo_tracing: DEFINES += GRILO_QT_TRACING
+
 # Generate pkg-config support by default
 # Note that we HAVE TO also create prl config as QMake implementation
 # mixes both of them together.
@@ -24,7 +27,9 @@ SOURCES += \
     grilobrowse.cpp \
     grilosearch.cpp \
     griloquery.cpp \
-    grilomultisearch.cpp
+    grilomultisearch.cpp \
+    grilogroupmodel.cpp \
+    grilotrace.cpp
 
 HEADERS += \
     griloqt.h \
@@ -35,7 +40,9 @@ HEADERS += \
     grilobrowse.h \
     grilosearch.h \
     griloquery.h \
-    grilomultisearch.h
+    grilomultisearch.h \
+    grilogroupmodel.h \
+    grilotrace.h
 
 INSTALL_HEADERS = \
     GriloQt \
@@ -46,6 +53,7 @@ INSTALL_HEADERS = \
     GriloBrowse \
     GriloQuery \
     GriloMultiSearch \
+    GriloGroupModel \
     griloqt.h \
     grilomodel.h \
     griloregistry.h \
@@ -54,7 +62,8 @@ INSTALL_HEADERS = \
     grilobrowse.h \
     grilosearch.h \
     griloquery.h \
-    grilomultisearch.h
+    grilomultisearch.h \
+    grilogroupmodel.h
 
 target.path = $$[QT_INSTALL_LIBS]
 headers.files = $$INSTALL_HEADERS
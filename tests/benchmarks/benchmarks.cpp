@@ -0,0 +1,327 @@
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "grilomocksource.h"
+
+#include <GriloModel>
+#include <GriloQuery>
+#include <GriloRegistry>
+
+#include <QEventLoop>
+#include <QHash>
+#include <QStringList>
+#include <QTimer>
+#include <QtTest>
+
+class GriloBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+
+    void insert_data();
+    void insert();
+    void refetch_data();
+    void refetch();
+    void data_data();
+    void data();
+    void removals_data();
+    void removals();
+    void teardown_data();
+    void teardown();
+
+private:
+    // Model showing a query on the mock source, deleting it deletes the query
+    GriloModel *createModel();
+    bool fetch(GriloModel *model);
+
+    GriloRegistry *m_registry;
+};
+
+void GriloBenchmarks::initTestCase()
+{
+    // Initializes Grilo
+    m_registry = new GriloRegistry(this);
+    QVERIFY(GriloMockSource::registerSource());
+    QVERIFY(m_registry->availableSources().contains(GriloMockSource::id()));
+}
+
+void GriloBenchmarks::cleanup()
+{
+    GriloMockSource::settings() = GriloMockSettings();
+}
+
+GriloModel *GriloBenchmarks::createModel()
+{
+    GriloModel *model = new GriloModel;
+    GriloQuery *query = new GriloQuery(model);
+
+    query->setRegistry(m_registry);
+    query->setSource(GriloMockSource::id());
+    query->setQuery("mock");
+    query->setIncrementalUpdates(true);
+    query->setMetadataKeys(QVariantList() << GriloDataSource::Title << GriloDataSource::Artist
+                           << GriloDataSource::Album << GriloDataSource::Duration);
+
+    model->setSource(query);
+
+    return model;
+}
+
+bool GriloBenchmarks::fetch(GriloModel *model)
+{
+    QEventLoop loop;
+    connect(model->source(), SIGNAL(finished()), &loop, SLOT(quit()));
+    QTimer::singleShot(120000, &loop, SLOT(quit()));
+
+    if (!model->source()->refresh()) {
+        return false;
+    }
+
+    loop.exec();
+
+    return !model->source()->fetching();
+}
+
+void GriloBenchmarks::insert_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("batchSize");
+    QTest::addColumn<int>("latency");
+
+    QTest::newRow("1000 rows") << 1000 << 100 << 0;
+    QTest::newRow("10000 rows") << 10000 << 100 << 0;
+    QTest::newRow("10000 rows, one per iteration") << 10000 << 1 << 0;
+    QTest::newRow("10000 rows, 2 ms latency") << 10000 << 500 << 2;
+    QTest::newRow("50000 rows") << 50000 << 1000 << 0;
+}
+
+void GriloBenchmarks::insert()
+{
+    QFETCH(int, rows);
+    QFETCH(int, batchSize);
+    QFETCH(int, latency);
+
+    GriloMockSource::settings().count = rows;
+    GriloMockSource::settings().batchSize = batchSize;
+    GriloMockSource::settings().latency = latency;
+
+    // Every iteration fills a new model, they are deleted after measuring so
+    // teardown is not part of the insert time.
+    QList<GriloModel *> models;
+
+    QBENCHMARK {
+        GriloModel *model = createModel();
+        models.append(model);
+        QVERIFY(fetch(model));
+    }
+
+    QCOMPARE(models.last()->rowCount(), rows);
+    qDeleteAll(models);
+}
+
+void GriloBenchmarks::refetch_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("shift");
+
+    QTest::newRow("1000 rows, unchanged") << 1000 << 0;
+    QTest::newRow("1000 rows, shifted") << 1000 << 10;
+    QTest::newRow("10000 rows, unchanged") << 10000 << 0;
+    QTest::newRow("10000 rows, shifted") << 10000 << 100;
+    // Every refetched row is matched through the id to row index, a Tracker
+    // library of this size took seconds when rows were looked up by scanning
+    QTest::newRow("50000 rows, unchanged") << 50000 << 0;
+    QTest::newRow("50000 rows, shifted") << 50000 << 500;
+}
+
+void GriloBenchmarks::refetch()
+{
+    QFETCH(int, rows);
+    QFETCH(int, shift);
+
+    GriloMockSource::settings().count = rows;
+    GriloMockSource::settings().batchSize = 1000;
+
+    GriloModel *model = createModel();
+    QVERIFY(fetch(model));
+
+    // A shifted refetch drops the first rows, moves the others up and adds
+    // as many at the end.
+    QBENCHMARK {
+        GriloMockSource::settings().idOffset = GriloMockSource::settings().idOffset == 0 ? shift : 0;
+        QVERIFY(fetch(model));
+    }
+
+    // The rows both fetches returned are updated in place, not inserted again.
+    QVariantMap stats = model->source()->stats();
+    QCOMPARE(stats.value("updates").toInt(), rows - shift);
+    QCOMPARE(stats.value("inserts").toInt(), shift);
+    QCOMPARE(stats.value("removals").toInt(), shift);
+
+    QCOMPARE(model->rowCount(), rows);
+    delete model;
+}
+
+// The role table data() built on every call before the model kept it
+static QHash<int, QByteArray> per_call_role_names()
+{
+    QHash<int, QByteArray> roleNames;
+
+    grl_init(0, 0);
+
+    roleNames[GriloModel::MediaRole] = "media";
+
+    int cursor = GRL_METADATA_KEY_INVALID;
+
+    while (const char *metadataKey = GRL_METADATA_KEY_GET_NAME(++cursor)) {
+        roleNames[GriloModel::MediaRole + cursor] = metadataKey;
+
+        QStringList splitKey = QString(metadataKey).split("-", QString::SkipEmptyParts);
+        if (splitKey.length() > 1) {
+            QByteArray camelCaseKey = splitKey[0].toUtf8();
+
+            for (int i = 1; i < splitKey.length(); i++) {
+                QString camelCase = splitKey[i];
+                camelCase[0] = camelCase[0].toUpper();
+                camelCaseKey += camelCase.toUtf8();
+            }
+
+            roleNames.insertMulti(GriloModel::MediaRole + cursor, camelCaseKey);
+        }
+    }
+
+    return roleNames;
+}
+
+void GriloBenchmarks::data_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("role");
+    QTest::addColumn<bool>("perCallRoleNames");
+
+    int title = GriloModel::MediaRole + GRL_METADATA_KEY_TITLE;
+    int duration = GriloModel::MediaRole + GRL_METADATA_KEY_DURATION;
+
+    QTest::newRow("10000 rows, title") << 10000 << title << false;
+    QTest::newRow("10000 rows, title, per call role names") << 10000 << title << true;
+    QTest::newRow("10000 rows, duration") << 10000 << duration << false;
+    QTest::newRow("10000 rows, duration, per call role names") << 10000 << duration << true;
+    QTest::newRow("10000 rows, media") << 10000 << int(GriloModel::MediaRole) << false;
+}
+
+void GriloBenchmarks::data()
+{
+    QFETCH(int, rows);
+    QFETCH(int, role);
+    QFETCH(bool, perCallRoleNames);
+
+    GriloMockSource::settings().count = rows;
+    GriloMockSource::settings().batchSize = 1000;
+
+    GriloModel *model = createModel();
+    QVERIFY(fetch(model));
+
+    // The per call rows add the role lookup data() did before the role
+    // table was kept, to compare against.
+    QBENCHMARK {
+        for (int i = 0; i < rows; ++i) {
+            if (perCallRoleNames && per_call_role_names().values(role).isEmpty()) {
+                continue;
+            }
+            model->data(model->index(i, 0), role);
+        }
+    }
+
+    delete model;
+}
+
+void GriloBenchmarks::removals_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("burst");
+
+    QTest::newRow("10000 rows, one by one") << 10000 << 1;
+    QTest::newRow("10000 rows, 100 per change") << 10000 << 100;
+    QTest::newRow("10000 rows, all at once") << 10000 << 5000;
+    QTest::newRow("50000 rows, 1000 per change") << 50000 << 1000;
+}
+
+void GriloBenchmarks::removals()
+{
+    QFETCH(int, rows);
+    QFETCH(int, burst);
+
+    GriloMockSource::settings().count = rows;
+    GriloMockSource::settings().batchSize = 1000;
+
+    GriloModel *model = createModel();
+    QVERIFY(fetch(model));
+
+    // Every other item, from the last one
+    QVector<int> items;
+    for (int i = rows - 1; i >= 0; i -= 2) {
+        items.append(i);
+    }
+
+    QBENCHMARK_ONCE {
+        GriloMockSource::notifyChange(GRL_CONTENT_REMOVED, items, burst);
+    }
+
+    QCOMPARE(model->rowCount(), rows - items.count());
+    delete model;
+}
+
+void GriloBenchmarks::teardown_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<bool>("wrappers");
+
+    QTest::newRow("10000 rows") << 10000 << false;
+    QTest::newRow("10000 rows with GriloMedia") << 10000 << true;
+    QTest::newRow("50000 rows") << 50000 << false;
+}
+
+void GriloBenchmarks::teardown()
+{
+    QFETCH(int, rows);
+    QFETCH(bool, wrappers);
+
+    GriloMockSource::settings().count = rows;
+    GriloMockSource::settings().batchSize = 1000;
+
+    GriloModel *model = createModel();
+    QVERIFY(fetch(model));
+
+    if (wrappers) {
+        for (int i = 0; i < rows; ++i) {
+            model->getMediaItem(i);
+        }
+    }
+
+    QBENCHMARK_ONCE {
+        delete model;
+    }
+}
+
+QTEST_MAIN(GriloBenchmarks)
+
+#include "benchmarks.moc"
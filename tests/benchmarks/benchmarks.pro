@@ -0,0 +1,19 @@
+TEMPLATE = app
+TARGET = grilo-qt5-benchmarks
+CONFIG += qt link_pkgconfig no_keywords testcase no_testcase_installs
+
+QT = core testlib
+
+PKGCONFIG = grilo-0.3
+
+DEPENDPATH += ../../src
+INCLUDEPATH += ../../src
+LIBS += -L../../src -lgrilo-qt5
+QMAKE_RPATHDIR += $$OUT_PWD/../../src
+
+SOURCES += \
+    benchmarks.cpp \
+    grilomocksource.cpp
+
+HEADERS += \
+    grilomocksource.h
@@ -0,0 +1,282 @@
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "grilomocksource.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QHash>
+
+typedef struct
+{
+    GrlSource parent;
+} GriloMockGrlSource;
+
+typedef struct
+{
+    GrlSourceClass parent_class;
+} GriloMockGrlSourceClass;
+
+GType grilo_mock_grl_source_get_type(void);
+
+G_DEFINE_TYPE(GriloMockGrlSource, grilo_mock_grl_source, GRL_TYPE_SOURCE)
+
+// A running query, results are delivered from the main loop
+struct GriloMockOperation
+{
+    GrlSourceQuerySpec *spec;
+    int next;
+    int end;
+    bool cancelled;
+};
+
+static GriloMockSettings mockSettings;
+static QHash<guint, GriloMockOperation *> mockOperations;
+static GrlSource *mockSource = 0;
+
+static const char *const genres[] = {
+    "Rock", "Pop", "Jazz", "Classical", "Electronic", "Folk", "Blues", "Soundtrack"
+};
+
+static GrlMedia *create_media(int number, const GList *keys)
+{
+    GrlMedia *media = grl_media_audio_new();
+    QByteArray id = "mock-" + QByteArray::number(number);
+    grl_media_set_id(media, id.constData());
+    grl_media_set_source(media, GriloMockSource::id());
+
+    for (const GList *it = keys; it; it = it->next) {
+        switch (GRLPOINTER_TO_KEYID(it->data)) {
+        case GRL_METADATA_KEY_TITLE:
+            grl_media_set_title(media, ("Track " + QByteArray::number(number)).constData());
+            break;
+        case GRL_METADATA_KEY_ARTIST:
+            grl_media_set_artist(media, ("Artist " + QByteArray::number(number % 100)).constData());
+            break;
+        case GRL_METADATA_KEY_ALBUM:
+            grl_media_set_album(media, ("Album " + QByteArray::number(number % 1000)).constData());
+            break;
+        case GRL_METADATA_KEY_GENRE:
+            grl_media_set_genre(media, genres[number % (sizeof(genres) / sizeof(genres[0]))]);
+            break;
+        case GRL_METADATA_KEY_DURATION:
+            grl_media_set_duration(media, 60 + number % 300);
+            break;
+        case GRL_METADATA_KEY_TRACK_NUMBER:
+            grl_media_set_track_number(media, number % 20 + 1);
+            break;
+        case GRL_METADATA_KEY_SIZE:
+            grl_media_set_size(media, 1000000 + number % 9000000);
+            break;
+        case GRL_METADATA_KEY_URL:
+            grl_media_set_url(media, ("file:///mock/" + QByteArray::number(number) + ".mp3").constData());
+            break;
+        case GRL_METADATA_KEY_MIME:
+            grl_media_set_mime(media, "audio/mpeg");
+            break;
+        case GRL_METADATA_KEY_MODIFICATION_DATE: {
+            GDateTime *dateTime = g_date_time_new_from_unix_utc(1400000000 + number);
+            grl_media_set_modification_date(media, dateTime);
+            g_date_time_unref(dateTime);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return media;
+}
+
+static gboolean deliver_results(gpointer user_data)
+{
+    GriloMockOperation *op = static_cast<GriloMockOperation *>(user_data);
+    GrlSourceQuerySpec *qs = op->spec;
+
+    if (op->cancelled || op->next == op->end) {
+        mockOperations.remove(qs->operation_id);
+        qs->callback(qs->source, qs->operation_id, NULL, 0, qs->user_data, NULL);
+        delete op;
+        return G_SOURCE_REMOVE;
+    }
+
+    int last = qMin(op->next + mockSettings.batchSize, op->end);
+    while (op->next < last && !op->cancelled) {
+        int remaining = op->end - op->next - 1;
+        GrlMedia *media = create_media(mockSettings.idOffset + op->next, qs->keys);
+        ++op->next;
+
+        if (remaining == 0) {
+            // The spec goes with the last result.
+            mockOperations.remove(qs->operation_id);
+            qs->callback(qs->source, qs->operation_id, media, 0, qs->user_data, NULL);
+            delete op;
+            return G_SOURCE_REMOVE;
+        }
+
+        qs->callback(qs->source, qs->operation_id, media, remaining, qs->user_data, NULL);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static const GList *grilo_mock_supported_keys(GrlSource *source)
+{
+    Q_UNUSED(source)
+
+    static GList *keys = 0;
+    if (!keys) {
+        const GrlKeyID supported[] = {
+            GRL_METADATA_KEY_ID, GRL_METADATA_KEY_TITLE, GRL_METADATA_KEY_ARTIST,
+            GRL_METADATA_KEY_ALBUM, GRL_METADATA_KEY_GENRE, GRL_METADATA_KEY_DURATION,
+            GRL_METADATA_KEY_TRACK_NUMBER, GRL_METADATA_KEY_SIZE, GRL_METADATA_KEY_URL,
+            GRL_METADATA_KEY_MIME, GRL_METADATA_KEY_MODIFICATION_DATE
+        };
+        for (unsigned i = 0; i < sizeof(supported) / sizeof(supported[0]); ++i) {
+            keys = g_list_append(keys, GRLKEYID_TO_POINTER(supported[i]));
+        }
+    }
+
+    return keys;
+}
+
+static GrlSupportedOps grilo_mock_supported_operations(GrlSource *source)
+{
+    Q_UNUSED(source)
+
+    return GrlSupportedOps(GRL_OP_QUERY | GRL_OP_NOTIFY_CHANGE);
+}
+
+static void grilo_mock_query(GrlSource *source, GrlSourceQuerySpec *qs)
+{
+    Q_UNUSED(source)
+
+    GriloMockOperation *op = new GriloMockOperation;
+    op->spec = qs;
+    op->next = qMin(int(grl_operation_options_get_skip(qs->options)), mockSettings.count);
+    op->end = mockSettings.count;
+    op->cancelled = false;
+
+    int count = grl_operation_options_get_count(qs->options);
+    if (count > 0) {
+        op->end = qMin(op->end, op->next + count);
+    }
+
+    mockOperations.insert(qs->operation_id, op);
+
+    if (mockSettings.latency > 0) {
+        g_timeout_add(mockSettings.latency, deliver_results, op);
+    } else {
+        g_idle_add(deliver_results, op);
+    }
+}
+
+static void grilo_mock_cancel(GrlSource *source, guint operation_id)
+{
+    Q_UNUSED(source)
+
+    GriloMockOperation *op = mockOperations.value(operation_id);
+    if (op) {
+        op->cancelled = true;
+    }
+}
+
+static gboolean grilo_mock_notify_change_start(GrlSource *source, GError **error)
+{
+    Q_UNUSED(source)
+    Q_UNUSED(error)
+
+    return TRUE;
+}
+
+static gboolean grilo_mock_notify_change_stop(GrlSource *source, GError **error)
+{
+    Q_UNUSED(source)
+    Q_UNUSED(error)
+
+    return TRUE;
+}
+
+static void grilo_mock_grl_source_class_init(GriloMockGrlSourceClass *klass)
+{
+    GrlSourceClass *source_class = GRL_SOURCE_CLASS(klass);
+
+    source_class->supported_keys = grilo_mock_supported_keys;
+    source_class->supported_operations = grilo_mock_supported_operations;
+    source_class->query = grilo_mock_query;
+    source_class->cancel = grilo_mock_cancel;
+    source_class->notify_change_start = grilo_mock_notify_change_start;
+    source_class->notify_change_stop = grilo_mock_notify_change_stop;
+}
+
+static void grilo_mock_grl_source_init(GriloMockGrlSource *source)
+{
+    Q_UNUSED(source)
+}
+
+const char *GriloMockSource::id()
+{
+    return "grl-qt-mock";
+}
+
+bool GriloMockSource::registerSource()
+{
+    if (mockSource) {
+        return true;
+    }
+
+    GrlRegistry *registry = grl_registry_get_default();
+    GrlPlugin *plugin = GRL_PLUGIN(g_object_new(GRL_TYPE_PLUGIN, NULL));
+    GrlSource *source = GRL_SOURCE(g_object_new(grilo_mock_grl_source_get_type(),
+                                                "source-id", id(),
+                                                "source-name", "Mock",
+                                                "source-desc", "Synthetic items for benchmarks",
+                                                NULL));
+
+    GError *error = NULL;
+    if (!grl_registry_register_source(registry, plugin, source, &error)) {
+        qWarning() << "Failed to register the mock source" << (error ? error->message : "");
+        g_clear_error(&error);
+        return false;
+    }
+
+    mockSource = source;
+    return true;
+}
+
+GriloMockSettings &GriloMockSource::settings()
+{
+    return mockSettings;
+}
+
+void GriloMockSource::notifyChange(GrlSourceChangeType type, const QVector<int> &items, int burst)
+{
+    for (int first = 0; first < items.count(); first += burst) {
+        int last = qMin(first + burst, items.count());
+
+        GPtrArray *changed = g_ptr_array_new_with_free_func(g_object_unref);
+        for (int i = first; i < last; ++i) {
+            GList keys = { GRLKEYID_TO_POINTER(GRL_METADATA_KEY_TITLE), 0, 0 };
+            g_ptr_array_add(changed, create_media(items.at(i), &keys));
+        }
+
+        // Takes the array.
+        grl_source_notify_change_list(mockSource, changed, type, FALSE);
+    }
+}
@@ -0,0 +1,69 @@
+// -*- c++ -*-
+
+/*!
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GRILO_MOCK_SOURCE_H
+#define GRILO_MOCK_SOURCE_H
+
+#include <QVector>
+
+#include <grilo.h>
+
+// What the mock source returns, read when a query starts
+struct GriloMockSettings
+{
+    GriloMockSettings()
+        : count(1000)
+        , batchSize(100)
+        , latency(0)
+        , idOffset(0)
+    {
+    }
+
+    // Items of every query, the skip and count of the operation apply
+    int count;
+    // Results delivered per main loop iteration
+    int batchSize;
+    // Milliseconds before every batch, 0 for the next idle iteration
+    int latency;
+    // Items are numbered from idOffset, the id of an item is "mock-<number>"
+    int idOffset;
+};
+
+// In process GrlSource answering queries with synthetic audio items. Only
+// the keys asked for by the operation are filled in, from the id, title,
+// artist, album, genre, duration, track number, size, url, mime type and
+// modification date supported by the source.
+class GriloMockSource
+{
+public:
+    static const char *id();
+
+    // Registers the source with the default Grilo registry, after grl_init()
+    static bool registerSource();
+
+    static GriloMockSettings &settings();
+
+    // Emits content-changed for the items with the given numbers, burst
+    // items per signal
+    static void notifyChange(GrlSourceChangeType type, const QVector<int> &items, int burst);
+};
+
+#endif /* GRILO_MOCK_SOURCE_H */